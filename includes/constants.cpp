@@ -8,4 +8,20 @@ const float KNOCKBACK_SPEED = 20.0f;
 const float KNIGHT_ATTACK_DELAY = 1.0f;
 const char *AUDIO_SHAW = "resources/audio/shaw.mp3";
 const char *AUDIO_EDINO = "resources/audio/hornet_edino.mp3";
-const char *AUDIO_HAA = "resources/audio/hornet_haa.mp3";
\ No newline at end of file
+const char *AUDIO_HAA = "resources/audio/hornet_haa.mp3";
+// pack model diffuse maps into texture arrays at load (needs GL 4.3)
+const bool PACK_TEXTURE_ARRAYS = true;
+// stream the mips of baked textures by on-screen size, within this much VRAM
+const bool STREAM_TEXTURES = true;
+const int TEXTURE_BUDGET_MB = 256;
+// extra hornets sharing the boss's model, drawn instanced (1000 as a stress
+// test); they only play an animation and take no part in the fight
+const int HORDE_SIZE = 0;
+// static stone slabs scattered around the arena, sharing one pooled model;
+// with GL 4.3 they cost one multi-draw per material however many there are
+const int PROP_COUNT = 0;
+// simulate the next frame while a render thread draws the last one
+const bool RENDER_THREAD = true;
+// dynamic resolution: GPU frame time to hold and the lowest scene scale
+const float FRAME_BUDGET_MS = 16.6f;
+const float MIN_RESOLUTION_SCALE = 0.5f;
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 #include <learnopengl/animation.h>
 #include <learnopengl/bone.h>
+#include <learnopengl/cpu_profiler.hpp>
 #include <map>
 #include <optional>
 #include <vector>
@@ -99,6 +100,7 @@ public:
   }
 
   void updateAnim(float deltaTime) {
+    PROFILE_ZONE("Animator::updateAnim");
     if (m_CurrentAnimation != nullptr) {
       float ticksPerSecond = m_CurrentAnimation->m_TicksPerSecond != 0
                                  ? m_CurrentAnimation->m_TicksPerSecond
@@ -212,7 +214,9 @@ public:
     return {};
   }
 
-  std::vector<glm::mat4> GetFinalBoneMatrices() { return m_FinalBoneMatrices; }
+  const std::vector<glm::mat4> &GetFinalBoneMatrices() const {
+    return m_FinalBoneMatrices;
+  }
 
   Animation *GetAnimation() { return m_CurrentAnimation; }
 
@@ -0,0 +1,304 @@
+#pragma once
+#include <assimp/texture.h>
+#include <glad/glad.h>
+#include <learnopengl/gl_state.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// File formats written by hk_bake (tools/hk_bake.cpp) and the runtime side
+// that picks them up. Everything lives under cache/baked, mirroring the
+// resources/ paths with '/' flattened to '_' so outputs are easy to diff.
+namespace BakedAssets {
+
+const uint32_t VERSION = 2;
+const uint32_t TEXTURE_MAGIC = 0x58544b48; // "HKTX"
+const uint32_t MESH_MAGIC = 0x534d4b48;    // "HKMS"
+const uint32_t ANIM_MAGIC = 0x4e414b48;    // "HKAN"
+
+enum class TextureFormat : uint32_t { RAW = 0, DXT1 = 1, DXT5 = 2 };
+
+struct TextureLevel {
+  uint32_t width = 0, height = 0;
+  std::vector<unsigned char> data;
+};
+
+struct Texture {
+  TextureFormat format = TextureFormat::RAW;
+  uint32_t channels = 4;
+  // rows stored bottom-up, as stb's vertical flip loads them; the game only
+  // flips embedded PNG/JPG textures (ModelAnimation::loadMaterialTextures)
+  uint32_t flipped = 0;
+  std::vector<TextureLevel> levels;
+};
+
+inline std::string &root() {
+  static std::string dir = "cache/baked";
+  return dir;
+}
+
+inline uint64_t hashBytes(const void *data, size_t size,
+                          uint64_t seed = 14695981039346656037ull) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  uint64_t h = seed;
+  for (size_t i = 0; i < size; i++) {
+    h ^= bytes[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+inline std::string hex(uint64_t value) {
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)value);
+  return buf;
+}
+
+inline std::string flatten(const std::string &path) {
+  std::string out = path;
+  for (char &c : out)
+    if (c == '/' || c == '\\' || c == ':')
+      c = '_';
+  return out;
+}
+
+// compressed embedded textures are stored as their file bytes, raw ones as
+// mWidth * mHeight texels
+inline size_t embeddedSize(const aiTexture *tex) {
+  return tex->mHeight == 0 ? tex->mWidth
+                           : (size_t)tex->mWidth * tex->mHeight * 4;
+}
+
+inline std::string textureFile(const std::string &sourcePath) {
+  return root() + "/textures/" + flatten(sourcePath) + ".hktex";
+}
+
+// embedded textures have no stable path, so they are content addressed
+inline std::string embeddedTextureFile(const aiTexture *tex) {
+  return root() + "/textures/embedded_" +
+         hex(hashBytes(tex->pcData, embeddedSize(tex))) + ".hktex";
+}
+
+inline std::string modelFile(const std::string &sourcePath) {
+  return root() + "/models/" + flatten(sourcePath) + ".hkmesh";
+}
+
+inline std::string animationFile(const std::string &sourcePath) {
+  return root() + "/models/" + flatten(sourcePath) + ".hkanim";
+}
+
+inline std::string audioFile(const std::string &sourcePath) {
+  return root() + "/audio/" + flatten(sourcePath) + ".wav";
+}
+
+// false when `source` changed after `baked` was written, e.g. an edited
+// texture not yet rebaked; an empty or missing source never makes it stale
+inline bool upToDate(const std::string &baked, const std::string &source) {
+  std::error_code ec;
+  if (!std::filesystem::exists(baked, ec))
+    return false;
+  if (source.empty() || !std::filesystem::exists(source, ec))
+    return true;
+  return std::filesystem::last_write_time(source, ec) <=
+         std::filesystem::last_write_time(baked, ec);
+}
+
+// the baked copy if hk_bake produced one, the source otherwise
+inline std::string resolveAudio(const std::string &sourcePath) {
+  std::string baked = audioFile(sourcePath);
+  std::error_code ec;
+  return std::filesystem::exists(baked, ec) ? baked : sourcePath;
+}
+
+// ------------------------------------------------------------------------
+// binary helpers, native (little) endian
+// ------------------------------------------------------------------------
+struct Writer {
+  std::ofstream out;
+  explicit Writer(const std::string &path)
+      : out(path, std::ios::binary | std::ios::trunc) {}
+  template <typename T> void pod(const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  void bytes(const void *data, size_t size) {
+    out.write(static_cast<const char *>(data), (std::streamsize)size);
+  }
+  void str(const std::string &s) {
+    pod((uint32_t)s.size());
+    bytes(s.data(), s.size());
+  }
+};
+
+struct Reader {
+  std::ifstream in;
+  explicit Reader(const std::string &path) : in(path, std::ios::binary) {}
+  template <typename T> T pod() {
+    T value{};
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+    return value;
+  }
+  void bytes(void *data, size_t size) {
+    in.read(static_cast<char *>(data), (std::streamsize)size);
+  }
+  std::string str() {
+    std::string s(pod<uint32_t>(), '\0');
+    bytes(s.data(), s.size());
+    return s;
+  }
+  bool ok() const { return (bool)in; }
+};
+
+inline bool writeTexture(const std::string &path, const Texture &tex) {
+  Writer w(path);
+  if (!w.out)
+    return false;
+  w.pod(TEXTURE_MAGIC);
+  w.pod(VERSION);
+  w.pod((uint32_t)tex.format);
+  w.pod(tex.channels);
+  w.pod(tex.flipped);
+  w.pod((uint32_t)tex.levels.size());
+  for (const TextureLevel &level : tex.levels) {
+    w.pod(level.width);
+    w.pod(level.height);
+    w.pod((uint32_t)level.data.size());
+    w.bytes(level.data.data(), level.data.size());
+  }
+  return (bool)w.out;
+}
+
+inline bool readTexture(const std::string &path, Texture &tex) {
+  Reader r(path);
+  if (!r.ok() || r.pod<uint32_t>() != TEXTURE_MAGIC ||
+      r.pod<uint32_t>() != VERSION)
+    return false;
+  tex.format = (TextureFormat)r.pod<uint32_t>();
+  tex.channels = r.pod<uint32_t>();
+  tex.flipped = r.pod<uint32_t>();
+  tex.levels.resize(r.pod<uint32_t>());
+  for (TextureLevel &level : tex.levels) {
+    level.width = r.pod<uint32_t>();
+    level.height = r.pod<uint32_t>();
+    level.data.resize(r.pod<uint32_t>());
+    r.bytes(level.data.data(), level.data.size());
+  }
+  return r.ok() && !tex.levels.empty();
+}
+
+// where each level of a baked texture sits in its file, so single levels can
+// be read later without the others (see TextureStreamer)
+struct TextureLevelEntry {
+  uint32_t width = 0, height = 0;
+  uint32_t size = 0;
+  uint64_t offset = 0;
+};
+
+struct TextureIndex {
+  TextureFormat format = TextureFormat::RAW;
+  uint32_t channels = 4;
+  uint32_t flipped = 0;
+  std::vector<TextureLevelEntry> levels;
+};
+
+inline bool readTextureIndex(const std::string &path, TextureIndex &index) {
+  Reader r(path);
+  if (!r.ok() || r.pod<uint32_t>() != TEXTURE_MAGIC ||
+      r.pod<uint32_t>() != VERSION)
+    return false;
+  index.format = (TextureFormat)r.pod<uint32_t>();
+  index.channels = r.pod<uint32_t>();
+  index.flipped = r.pod<uint32_t>();
+  index.levels.resize(r.pod<uint32_t>());
+  for (TextureLevelEntry &level : index.levels) {
+    level.width = r.pod<uint32_t>();
+    level.height = r.pod<uint32_t>();
+    level.size = r.pod<uint32_t>();
+    level.offset = (uint64_t)r.in.tellg();
+    r.in.seekg(level.size, std::ios::cur);
+  }
+  return r.ok() && !index.levels.empty();
+}
+
+inline bool readTextureLevel(const std::string &path,
+                             const TextureLevelEntry &level,
+                             std::vector<unsigned char> &data) {
+  Reader r(path);
+  r.in.seekg((std::streamoff)level.offset);
+  data.resize(level.size);
+  r.bytes(data.data(), data.size());
+  return r.ok();
+}
+
+// uploads one level into the GL_TEXTURE_2D currently bound
+inline void uploadLevel(TextureFormat format, uint32_t channels, GLint level,
+                        uint32_t width, uint32_t height,
+                        const std::vector<unsigned char> &data) {
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (format == TextureFormat::RAW) {
+    GLenum pixels = (channels == 1)   ? GL_RED
+                    : (channels == 2) ? GL_RG
+                    : (channels == 3) ? GL_RGB
+                                      : GL_RGBA;
+    glTexImage2D(GL_TEXTURE_2D, level, pixels, width, height, 0, pixels,
+                 GL_UNSIGNED_BYTE, data.data());
+    if (channels == 2) {
+      // grey + alpha: sample as (grey, grey, grey, alpha)
+      const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+      glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+  } else {
+    GLenum compressed = format == TextureFormat::DXT1
+                            ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                            : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, compressed, width, height, 0,
+                           (GLsizei)data.size(), data.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// the sampling state TextureFromFile uses, for the bound GL_TEXTURE_2D
+inline void setSampling() {
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// Uploads a baked texture with the same sampling state TextureFromFile uses.
+// Returns 0 when there is no usable baked file so callers can fall back:
+// missing, older than `source`, or not in the orientation (`flipped`) the
+// caller would load the source in.
+inline unsigned int loadTexture(const std::string &path, bool flipped,
+                                const std::string &source = "") {
+  Texture tex;
+  if (!upToDate(path, source) || !readTexture(path, tex) ||
+      tex.flipped != (uint32_t)flipped)
+    return 0;
+
+  unsigned int textureID;
+  glGenTextures(1, &textureID);
+  GLState::bindTexture(GL_TEXTURE_2D, textureID);
+  for (size_t i = 0; i < tex.levels.size(); i++) {
+    const TextureLevel &level = tex.levels[i];
+    uploadLevel(tex.format, tex.channels, (GLint)i, level.width, level.height,
+                level.data);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  (GLint)tex.levels.size() - 1);
+  setSampling();
+  return textureID;
+}
+
+} // namespace BakedAssets
@@ -0,0 +1,241 @@
+#pragma once
+#include "learnopengl/gl_state.hpp"
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Headless benchmark mode for frame-time regression runs.
+//
+//   bin/main --benchmark [--frames N] [--warmup N] [--size WxH]
+//            [--capture-every N] [--out DIR] [--osmesa]
+//            [--baseline DIR/summary.txt] [--tolerance 0.1]
+//
+// The game then runs without a display: an invisible window on GLFW's null
+// platform (where available) with an EGL surfaceless or OSMesa context, so it
+// works on machines without a GPU through Mesa's llvmpipe. The frame is
+// rendered into an offscreen target of the requested size instead of the
+// default framebuffer. Time advances by a fixed step, the random seed is
+// fixed and the camera orbits at a fixed rate, so every run plays the same
+// scene.
+//
+// After `frames` measured frames (the first `warmup` are not counted) the
+// CPU frame times go to DIR/frametimes.csv and a key=value summary to
+// DIR/summary.txt. Every `capture-every`th frame is also written as
+// DIR/frame_NNNNN.ppm. With a baseline summary, a median or p95 more than
+// `tolerance` above the baseline fails the run.
+class Benchmark {
+public:
+  static constexpr float STEP = 1.0f / 60.0f;
+  static constexpr float ORBIT_DEGREES_PER_FRAME = 0.5f;
+  static const unsigned SEED = 1;
+
+  struct Options {
+    bool enabled = false;
+    int frames = 600;
+    int warmup = 60;
+    int width = 1280;
+    int height = 720;
+    int captureEvery = 0; // 0: no images
+    std::string outDir = "benchmark";
+    bool osmesa = false;
+    std::string baseline;
+    double tolerance = 0.1;
+  };
+
+  // false (after printing why) on a malformed command line
+  static bool parse(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "--benchmark") {
+        options.enabled = true;
+      } else if (arg == "--osmesa") {
+        options.osmesa = true;
+      } else if (arg == "--frames" && hasValue) {
+        options.frames = std::atoi(argv[++i]);
+      } else if (arg == "--warmup" && hasValue) {
+        options.warmup = std::atoi(argv[++i]);
+      } else if (arg == "--capture-every" && hasValue) {
+        options.captureEvery = std::atoi(argv[++i]);
+      } else if (arg == "--out" && hasValue) {
+        options.outDir = argv[++i];
+      } else if (arg == "--baseline" && hasValue) {
+        options.baseline = argv[++i];
+      } else if (arg == "--tolerance" && hasValue) {
+        options.tolerance = std::atof(argv[++i]);
+      } else if (arg == "--size" && hasValue) {
+        if (std::sscanf(argv[++i], "%dx%d", &options.width,
+                        &options.height) != 2) {
+          std::cout << "ERROR::BENCHMARK:: --size expects WIDTHxHEIGHT"
+                    << std::endl;
+          return false;
+        }
+      } else {
+        std::cout << "ERROR::BENCHMARK:: unknown argument " << arg
+                  << std::endl;
+        return false;
+      }
+    }
+    if (options.frames <= 0 || options.warmup < 0 || options.width <= 0 ||
+        options.height <= 0) {
+      std::cout << "ERROR::BENCHMARK:: frames and size must be positive"
+                << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  Options options;
+
+  explicit Benchmark(const Options &options) : options(options) {}
+
+  // creates the offscreen target; needs the GL context
+  void createTarget() {
+    glGenTextures(1, &color);
+    GLState::bindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, options.width, options.height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenFramebuffers(1, &fbo);
+    GLState::bindFramebuffer(fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           color, 0);
+    GLState::bindFramebuffer(0);
+  }
+
+  // stands in for the default framebuffer
+  GLuint target() const { return color; }
+  GLuint framebuffer() const { return fbo; }
+
+  // simulated seconds since the start
+  float time() const { return (frame + 1) * STEP; }
+  bool done() const { return frame >= options.warmup + options.frames; }
+
+  void beginFrame() { start = std::chrono::steady_clock::now(); }
+
+  // closes the frame's CPU timing and writes its image if one is due
+  void endFrame() {
+    auto end = std::chrono::steady_clock::now();
+    if (frame >= options.warmup)
+      frameMs.push_back(
+          std::chrono::duration<double, std::milli>(end - start).count());
+    if (options.captureEvery > 0 && frame >= options.warmup &&
+        (frame - options.warmup) % options.captureEvery == 0)
+      capture();
+    frame++;
+  }
+
+  // writes the report; false when the files cannot be written or the run is
+  // slower than the baseline
+  bool finish() {
+    if (frameMs.empty()) {
+      std::cout << "ERROR::BENCHMARK:: stopped before any measured frame"
+                << std::endl;
+      return false;
+    }
+    std::filesystem::create_directories(options.outDir);
+    std::ofstream csv(options.outDir + "/frametimes.csv");
+    csv << "frame,ms\n";
+    for (size_t i = 0; i < frameMs.size(); i++)
+      csv << i << ',' << frameMs[i] << '\n';
+
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double ms : sorted)
+      total += ms;
+    std::map<std::string, double> summary = {
+        {"frames", (double)sorted.size()},
+        {"mean_ms", total / sorted.size()},
+        {"median_ms", percentile(sorted, 0.50)},
+        {"p95_ms", percentile(sorted, 0.95)},
+        {"p99_ms", percentile(sorted, 0.99)},
+        {"min_ms", sorted.front()},
+        {"max_ms", sorted.back()}};
+    std::ofstream out(options.outDir + "/summary.txt");
+    out << "width=" << options.width << "\nheight=" << options.height << '\n';
+    for (auto &[key, value] : summary) {
+      out << key << '=' << value << '\n';
+      std::cout << "benchmark " << key << ": " << value << std::endl;
+    }
+    if (!csv || !out) {
+      std::cout << "ERROR::BENCHMARK:: cannot write to " << options.outDir
+                << std::endl;
+      return false;
+    }
+    return options.baseline.empty() || compare(summary);
+  }
+
+private:
+  GLuint color = 0;
+  GLuint fbo = 0;
+  int frame = 0;
+  std::chrono::steady_clock::time_point start;
+  std::vector<double> frameMs;
+
+  static double percentile(const std::vector<double> &sorted, double q) {
+    size_t index = (size_t)(q * (double)(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+  }
+
+  void capture() {
+    std::vector<unsigned char> pixels((size_t)options.width * options.height *
+                                      3);
+    GLState::bindFramebuffer(fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, options.width, options.height, GL_RGB,
+                 GL_UNSIGNED_BYTE, pixels.data());
+    GLState::bindFramebuffer(0);
+
+    std::filesystem::create_directories(options.outDir);
+    char name[32];
+    std::snprintf(name, sizeof(name), "/frame_%05d.ppm",
+                  frame - options.warmup);
+    std::ofstream out(options.outDir + name, std::ios::binary);
+    out << "P6\n" << options.width << ' ' << options.height << "\n255\n";
+    // GL rows start at the bottom
+    size_t row = (size_t)options.width * 3;
+    for (int y = options.height - 1; y >= 0; y--)
+      out.write((const char *)pixels.data() + y * row, row);
+  }
+
+  bool compare(const std::map<std::string, double> &summary) const {
+    std::ifstream in(options.baseline);
+    if (!in) {
+      std::cout << "ERROR::BENCHMARK:: cannot read baseline "
+                << options.baseline << std::endl;
+      return false;
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(in, line)) {
+      size_t eq = line.find('=');
+      if (eq != std::string::npos)
+        baseline[line.substr(0, eq)] = std::atof(line.c_str() + eq + 1);
+    }
+    bool passed = true;
+    for (const char *key : {"median_ms", "p95_ms"}) {
+      auto it = baseline.find(key);
+      if (it == baseline.end())
+        continue;
+      double limit = it->second * (1.0 + options.tolerance);
+      if (summary.at(key) > limit) {
+        std::cout << "benchmark regression: " << key << ' ' << summary.at(key)
+                  << " > " << limit << " (baseline " << it->second << ")"
+                  << std::endl;
+        passed = false;
+      }
+    }
+    return passed;
+  }
+};
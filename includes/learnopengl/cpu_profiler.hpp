@@ -0,0 +1,211 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU frame profiler: nanosecond zones recorded into per-thread rings.
+//
+//   PROFILE_ZONE("GrassField::draw"); // times the rest of the block
+//   PROFILE_FRAME();                  // once per frame, on the main thread
+//
+// A zone writes one Event when it closes, into a ring owned by the calling
+// thread. The ring's own mutex is only contended while another thread reads
+// it (the overlay or a trace dump), so recording never waits on other
+// writers. Names must be string literals (only the pointer is stored). The
+// last FRAMES frame boundaries are kept as well, which is what the flame
+// graph overlay walks; writeChromeTrace() dumps every ring in the Trace Event
+// format understood by chrome://tracing and Perfetto.
+//
+// Everything is compiled in only with HK_PROFILE defined (the HK_PROFILE
+// CMake option); otherwise the macros expand to nothing.
+namespace CpuProfiler {
+
+// events kept per thread, a power of two
+const size_t RING = 1 << 16;
+// frame boundaries kept for the overlay
+const size_t FRAMES = 120;
+
+struct Event {
+  const char *name;
+  uint64_t start; // ns since the profiler clock started
+  uint64_t end;
+  int depth;
+};
+
+struct Frame {
+  uint64_t start;
+  uint64_t end;
+};
+
+struct ThreadBuffer {
+  uint32_t id = 0;
+  int depth = 0;        // zones currently open on this thread, owner only
+  uint64_t written = 0; // guarded by mutex, like events
+  std::vector<Event> events = std::vector<Event>(RING);
+  mutable std::mutex mutex;
+
+  void push(const Event &event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    events[written++ & (RING - 1)] = event;
+  }
+
+  // calls fn for every event still in the ring, oldest first; the owner
+  // thread blocks in push() meanwhile, so keep fn short
+  template <typename Fn> void forEach(Fn fn) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t first = written > RING ? written - RING : 0;
+    for (uint64_t i = first; i < written; i++)
+      fn(events[i & (RING - 1)]);
+  }
+};
+
+inline uint64_t now() {
+  static const auto origin = std::chrono::steady_clock::now();
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - origin)
+      .count();
+}
+
+inline std::mutex &registryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// every thread that ever recorded; buffers outlive their threads so a trace
+// written later still has them
+inline std::vector<std::shared_ptr<ThreadBuffer>> &registry() {
+  static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  return buffers;
+}
+
+inline ThreadBuffer &threadBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+    auto created = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(registryMutex());
+    created->id = (uint32_t)registry().size();
+    registry().push_back(created);
+    return created;
+  }();
+  return *buffer;
+}
+
+// the id the calling thread's events carry, e.g. for eventsIn()
+inline uint32_t threadId() { return threadBuffer().id; }
+
+struct FrameRing {
+  std::vector<Frame> frames = std::vector<Frame>(FRAMES);
+  uint64_t count = 0;
+  uint64_t lastMark = 0;
+};
+
+inline FrameRing &frameRing() {
+  static FrameRing ring;
+  return ring;
+}
+
+// closes the frame that started at the previous mark
+inline void markFrame() {
+  FrameRing &ring = frameRing();
+  uint64_t t = now();
+  if (ring.lastMark != 0)
+    ring.frames[ring.count++ % FRAMES] = {ring.lastMark, t};
+  ring.lastMark = t;
+}
+
+// the last `FRAMES` complete frames, oldest first
+inline std::vector<Frame> recentFrames() {
+  const FrameRing &ring = frameRing();
+  std::vector<Frame> result;
+  uint64_t first = ring.count > FRAMES ? ring.count - FRAMES : 0;
+  for (uint64_t i = first; i < ring.count; i++)
+    result.push_back(ring.frames[i % FRAMES]);
+  return result;
+}
+
+// events of thread `thread` (see threadId()) that lie inside `frame`
+inline std::vector<Event> eventsIn(const Frame &frame, uint32_t thread) {
+  std::shared_ptr<ThreadBuffer> buffer;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    if (thread < registry().size())
+      buffer = registry()[thread];
+  }
+  std::vector<Event> result;
+  if (!buffer)
+    return result;
+  buffer->forEach([&](const Event &e) {
+    if (e.start >= frame.start && e.end <= frame.end)
+      result.push_back(e);
+  });
+  return result;
+}
+
+class Zone {
+public:
+  explicit Zone(const char *name) : name(name), start(now()) {
+    depth = threadBuffer().depth++;
+  }
+  ~Zone() {
+    ThreadBuffer &buffer = threadBuffer();
+    buffer.depth--;
+    buffer.push({name, start, now(), depth});
+  }
+  Zone(const Zone &) = delete;
+  Zone &operator=(const Zone &) = delete;
+
+private:
+  const char *name;
+  uint64_t start;
+  int depth;
+};
+
+// every recorded event as complete ("X") events, timestamps in microseconds
+inline bool writeChromeTrace(const std::string &path) {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  // microseconds with ns digits; the default 6 significant digits would
+  // turn timestamps past one second into 1.23457e+06
+  out << std::fixed << std::setprecision(3);
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    buffers = registry();
+  }
+  // copied out first, so the recording threads are not held up by the file
+  std::vector<Event> events;
+  for (const std::shared_ptr<ThreadBuffer> &buffer : buffers) {
+    events.clear();
+    buffer->forEach([&](const Event &e) { events.push_back(e); });
+    for (const Event &e : events) {
+      out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name
+          << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->id
+          << ",\"ts\":" << e.start / 1000.0
+          << ",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+  return (bool)out;
+}
+
+} // namespace CpuProfiler
+
+#ifdef HK_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                     \
+  CpuProfiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() CpuProfiler::markFrame()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME()
+#endif
@@ -1,3 +1,4 @@
+#include "learnopengl/gl_state.hpp"
 #include "learnopengl/shader.h"
 #include "stb_image.h"
 #include <learnopengl/filesystem.h>
@@ -16,7 +17,7 @@ public:
   unsigned int loadCubemap(std::vector<std::string> faces) {
     stbi_set_flip_vertically_on_load(false);
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLState::bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++) {
@@ -73,8 +74,8 @@ public:
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::bindVertexArray(VAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices,
                  GL_STATIC_DRAW);
 
@@ -82,34 +83,29 @@ public:
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
                           (void *)0);
 
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
   }
 
-  void draw(Shader skyboxShader, glm::mat4 view, glm::mat4 projection) {
-    glDepthFunc(GL_LEQUAL);
+  // view and projection come from the UniformRing's Frame block, which must
+  // already be bound
+  void draw(Shader &skyboxShader) {
+    GLState::depthFunc(GL_LEQUAL);
+    GLState::polygonMode(GL_FILL);
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
-    // The "infinite distance" trick: Remove the translation component (4th
-    // column) from the view matrix. By converting view to a 3x3 matrix and then
-    // back to 4x4, we zero out the translation.
-    glm::mat4 modifiedView = glm::mat4(glm::mat3(view));
-
-    // Set uniforms
-    skyboxShader.setMat4("view", modifiedView);
-    skyboxShader.setMat4("projection", projection);
+    // The "infinite distance" trick (dropping the translation of the view
+    // matrix) is done in skybox.vert.
 
     // Draw the cube
-    glBindVertexArray(VAO);
+    GLState::bindVertexArray(VAO);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 
     // Restore the depth function for subsequent rendering
-    glDepthFunc(GL_LESS);
+    GLState::depthFunc(GL_LESS);
   }
 };
\ No newline at end of file
@@ -0,0 +1,165 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <learnopengl/entity.h>
+#include <learnopengl/hiz.hpp>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/render_queue.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// Frustum culling for animated models, on top of the entity.h volumes.
+//
+// Bounds are world-space AABBs recomputed every frame from the pose that is
+// about to be drawn. A skinned vertex is a weighted blend of its position
+// under each influencing bone, so it always lies inside the union of the
+// mesh's bind-pose box transformed by each of those bones; non-skinned meshes
+// just transform their box by the mesh's node matrix. Both are padded by
+// MARGIN to cover weights that do not sum to exactly one.
+namespace Culling {
+
+// fraction of the box diagonal added on every side
+const float MARGIN = 0.05f;
+
+struct Stats {
+  unsigned int display = 0; // models (or entities) that passed
+  unsigned int total = 0;
+  unsigned int meshDisplay = 0; // meshes queued
+  unsigned int meshTotal = 0;
+  unsigned int occluded = 0; // in the frustum but hidden according to Hi-Z
+  unsigned int meshOccluded = 0;
+};
+
+inline Stats &frameStats() {
+  static Stats stats;
+  return stats;
+}
+
+inline Stats &lastFrameStats() {
+  static Stats stats;
+  return stats;
+}
+
+// counts of the previous complete frame
+inline const Stats &lastFrame() { return lastFrameStats(); }
+
+inline void endFrame() {
+  lastFrameStats() = frameStats();
+  frameStats() = Stats();
+}
+
+struct Bounds {
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+  bool empty() const { return min.x > max.x; }
+
+  void add(const Bounds &other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  // grows by the box of `box` under `transform`
+  void add(const MeshAABB &box, const glm::mat4 &transform) {
+    for (int i = 0; i < 8; ++i) {
+      glm::vec3 corner((i & 1) ? box.mMax.x : box.mMin.x,
+                       (i & 2) ? box.mMax.y : box.mMin.y,
+                       (i & 4) ? box.mMax.z : box.mMin.z);
+      glm::vec3 p = glm::vec3(transform * glm::vec4(corner, 1.0f));
+      min = glm::min(min, p);
+      max = glm::max(max, p);
+    }
+  }
+
+  AABB volume() const {
+    glm::vec3 pad = glm::vec3(glm::length(max - min) * MARGIN);
+    return AABB(min - pad, max + pad);
+  }
+};
+
+// world bounds of `mesh` as drawn with `world` and the bone palette `bones`
+inline Bounds meshBounds(const Mesh &mesh, const glm::mat4 &world,
+                         const std::vector<glm::mat4> &bones) {
+  Bounds bounds;
+  if (!mesh.hasBones || mesh.hasUnweightedVertices ||
+      mesh.influencingBones.empty())
+    bounds.add(mesh.mAABB, world);
+  for (int bone : mesh.influencingBones)
+    if (bone < (int)bones.size())
+      bounds.add(mesh.mAABB, world * bones[bone]);
+  return bounds;
+}
+
+// Calls `visit(meshIndex, transform)` for every mesh of `model` that touches
+// `frustum` and is not hidden according to `occlusion` (optional), and
+// returns whether any was visited. The union of the mesh bounds is tested
+// first, so an off-screen or hidden actor is rejected with a single test.
+template <typename Visit>
+bool visibleMeshes(Model &model, const glm::mat4 &objectModel,
+                   IAnimator &animator, const std::vector<glm::mat4> &bones,
+                   const Frustum &frustum, HiZ *occlusion, Visit visit) {
+  struct Candidate {
+    glm::mat4 transform;
+    Bounds bounds;
+  };
+  static std::vector<Candidate> candidates;
+  candidates.clear();
+
+  Stats &stats = frameStats();
+  stats.total++;
+  stats.meshTotal += (unsigned int)model.meshes.size();
+
+  Bounds modelBounds;
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    glm::mat4 transform = objectModel * model.MeshTransform(i, animator);
+    candidates.push_back({transform, meshBounds(model.meshes[i], transform,
+                                                bones)});
+    modelBounds.add(candidates.back().bounds);
+  }
+  if (modelBounds.empty() || !modelBounds.volume().isOnFrustum(frustum))
+    return false;
+  if (occlusion && occlusion->occluded(modelBounds.volume())) {
+    stats.occluded++;
+    return false;
+  }
+
+  bool any = false;
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    AABB volume = candidates[i].bounds.volume();
+    if (!volume.isOnFrustum(frustum))
+      continue;
+    if (occlusion && occlusion->occluded(volume)) {
+      stats.meshOccluded++;
+      continue;
+    }
+    visit(i, candidates[i].transform);
+    stats.meshDisplay++;
+    any = true;
+  }
+  if (any)
+    stats.display++;
+  return any;
+}
+
+// Queues the visible meshes of `model` (see visibleMeshes) and returns
+// whether any were queued.
+inline bool submit(RenderQueue &queue, Model &model,
+                   const glm::mat4 &objectModel, IAnimator &animator,
+                   const std::vector<glm::mat4> &bones,
+                   ShaderVariants &shaders,
+                   const RenderObject &object, const Frustum &frustum,
+                   HiZ *occlusion = nullptr) {
+  uint32_t objectIndex = UINT32_MAX;
+  return visibleMeshes(
+      model, objectModel, animator, bones, frustum, occlusion,
+      [&](unsigned int i, const glm::mat4 &transform) {
+        // only objects with a visible mesh take a slot in the queue
+        if (objectIndex == UINT32_MAX)
+          objectIndex = queue.addObject(object);
+        queue.submit(shaders, model.meshes[i], transform, objectIndex);
+      });
+}
+
+} // namespace Culling
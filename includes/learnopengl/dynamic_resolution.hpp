@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+// Picks the resolution scale of the 3D scene from the measured GPU frame
+// time, so frame pacing holds on weak GPUs.
+//
+// update() smooths the frame time and, once it leaves the dead band around
+// the budget, moves the scale towards budget / time. The cost of the scene is
+// roughly proportional to its pixel count, the square of the scale, hence the
+// square root. Scales are quantized to STEP and changes are at least
+// COOLDOWN frames apart: every new size makes the render graph allocate new
+// targets, and the GPU timings only reflect a change a few frames later.
+class DynamicResolution {
+public:
+  static constexpr float STEP = 0.05f;
+  static const int COOLDOWN = 15;
+  // no change while the smoothed time is within this fraction of the budget
+  static constexpr float DEAD_BAND = 0.1f;
+
+  float budgetMs;
+  float minScale, maxScale;
+  bool enabled = true;
+
+  explicit DynamicResolution(float budgetMs, float minScale = 0.5f,
+                             float maxScale = 1.0f)
+      : budgetMs(budgetMs), minScale(minScale), maxScale(maxScale),
+        current(maxScale) {}
+
+  // feed the GPU time of the newest finished frame, 0 when there is none yet
+  void update(double gpuMs) {
+    if (!enabled) {
+      current = maxScale;
+      return;
+    }
+    if (gpuMs <= 0.0)
+      return;
+    smoothedMs = smoothedMs == 0.0f
+                     ? (float)gpuMs
+                     : smoothedMs + 0.1f * ((float)gpuMs - smoothedMs);
+    if (++framesSinceChange < COOLDOWN)
+      return;
+    if (std::abs(smoothedMs - budgetMs) < DEAD_BAND * budgetMs)
+      return;
+
+    float target = current * std::sqrt(budgetMs / smoothedMs);
+    target = std::round(target / STEP) * STEP;
+    target = std::clamp(target, minScale, maxScale);
+    if (target != current) {
+      current = target;
+      framesSinceChange = 0;
+    }
+  }
+
+  float scale() const { return current; }
+  float smoothedGpuMs() const { return smoothedMs; }
+
+  // scene size along an axis that is `native` pixels on screen
+  int scaled(int native) const {
+    return std::max(1, (int)std::lround(native * current));
+  }
+
+private:
+  float current;
+  float smoothedMs = 0.0f;
+  int framesSinceChange = 0;
+};
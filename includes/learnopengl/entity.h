@@ -2,9 +2,17 @@
 #define ENTITY_H
 
 #include <glm/glm.hpp> //glm::mat4
+#include <glm/gtc/matrix_transform.hpp> //glm::rotate, glm::translate
 #include <list> //std::list
 #include <array> //std::array
 #include <memory> //std::unique_ptr
+#include <algorithm> //std::min, std::max
+#include <cmath> //std::abs, tanf
+#include <limits> //std::numeric_limits
+
+#include <learnopengl/camera.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/render_queue.hpp>
 
 class Transform
 {
@@ -65,7 +73,7 @@ public:
 		m_isDirty = true;
 	}
 
-	const glm::vec3& getGlobalPosition() const
+	glm::vec3 getGlobalPosition() const
 	{
 		return m_modelMatrix[3];
 	}
@@ -171,6 +179,8 @@ struct BoundingVolume
 
 struct Sphere : public BoundingVolume
 {
+	using BoundingVolume::isOnFrustum; //world space test, not hidden by the override below
+
 	glm::vec3 center{ 0.f, 0.f, 0.f };
 	float radius{ 0.f };
 
@@ -209,6 +219,8 @@ struct Sphere : public BoundingVolume
 
 struct SquareAABB : public BoundingVolume
 {
+	using BoundingVolume::isOnFrustum;
+
 	glm::vec3 center{ 0.f, 0.f, 0.f };
 	float extent{ 0.f };
 
@@ -258,6 +270,8 @@ struct SquareAABB : public BoundingVolume
 
 struct AABB : public BoundingVolume
 {
+	using BoundingVolume::isOnFrustum;
+
 	glm::vec3 center{ 0.f, 0.f, 0.f };
 	glm::vec3 extents{ 0.f, 0.f, 0.f };
 
@@ -326,7 +340,7 @@ struct AABB : public BoundingVolume
 	};
 };
 
-Frustum createFrustumFromCamera(const Camera& cam, float aspect, float fovY, float zNear, float zFar)
+inline Frustum createFrustumFromCamera(const Camera& cam, float aspect, float fovY, float zNear, float zFar)
 {
 	Frustum     frustum;
 	const float halfVSide = zFar * tanf(fovY * .5f);
@@ -342,10 +356,10 @@ Frustum createFrustumFromCamera(const Camera& cam, float aspect, float fovY, flo
 	return frustum;
 }
 
-AABB generateAABB(const Model& model)
+inline AABB generateAABB(const Model& model)
 {
 	glm::vec3 minAABB = glm::vec3(std::numeric_limits<float>::max());
-	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::min());
+	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::lowest());
 	for (auto&& mesh : model.meshes)
 	{
 		for (auto&& vertex : mesh.vertices)
@@ -362,10 +376,10 @@ AABB generateAABB(const Model& model)
 	return AABB(minAABB, maxAABB);
 }
 
-Sphere generateSphereBV(const Model& model)
+inline Sphere generateSphereBV(const Model& model)
 {
 	glm::vec3 minAABB = glm::vec3(std::numeric_limits<float>::max());
-	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::min());
+	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::lowest());
 	for (auto&& mesh : model.meshes)
 	{
 		for (auto&& vertex : mesh.vertices)
@@ -383,6 +397,22 @@ Sphere generateSphereBV(const Model& model)
 	return Sphere((maxAABB + minAABB) * 0.5f, glm::length(minAABB - maxAABB));
 }
 
+//Animator for models drawn in bind pose: no node channels, so every mesh keeps its node transform
+class StaticPose : public IAnimator
+{
+public:
+	std::optional<glm::mat4> GetGlobalNodeTransform(std::string) override { return std::nullopt; }
+	std::optional<glm::mat4> getMeshTransform(unsigned int, float) override { return std::nullopt; }
+	float getFrame() override { return 0.0f; }
+
+	//Skinned meshes in bind pose: every final bone matrix is identity
+	static const std::vector<glm::mat4>& bones()
+	{
+		static const std::vector<glm::mat4> identity(UniformRing::MAX_BONES, glm::mat4(1.0f));
+		return identity;
+	}
+};
+
 class Entity
 {
 public:
@@ -466,19 +496,23 @@ public:
 	}
 
 
-	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, unsigned int& display, unsigned int& total)
+	//Queues every entity whose bounds touch the frustum; display/total count the visible and visited entities
+	void drawSelfAndChild(const Frustum& frustum, RenderQueue& queue, ShaderVariants& shaders, unsigned int& display, unsigned int& total)
 	{
 		if (boundingVolume->isOnFrustum(frustum, transform))
 		{
-			ourShader.setMat4("model", transform.getModelMatrix());
-			pModel->Draw(ourShader);
+			static StaticPose pose;
+			RenderObject object;
+			object.bones = StaticPose::bones().data();
+			object.boneCount = (int)StaticPose::bones().size();
+			pModel->Submit(queue, transform.getModelMatrix(), pose, shaders, queue.addObject(object));
 			display++;
 		}
 		total++;
 
 		for (auto&& child : children)
 		{
-			child->drawSelfAndChild(frustum, ourShader, display, total);
+			child->drawSelfAndChild(frustum, queue, shaders, display, total);
 		}
 	}
 };
@@ -0,0 +1,267 @@
+#pragma once
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the renderer touches (program, VAO, buffers,
+// texture units, depth/blend/cull/polygon state) so redundant calls never
+// reach the driver. Only valid while every change goes through here; code that
+// calls GL directly must call invalidate() afterwards.
+//
+// Every wrapper counts the call as issued or elided; endFrame() publishes the
+// counts of the frame that just finished in lastFrame().
+namespace GLState {
+
+const unsigned int MAX_TEXTURE_UNITS = 32;
+// an id/value GL never hands out, marks a slot as unknown
+const GLuint UNKNOWN = ~0u;
+
+struct Stats {
+  unsigned int issued = 0;
+  unsigned int elided = 0;
+};
+
+struct TextureUnit {
+  GLuint texture2D = 0;
+  GLuint texture2DArray = 0;
+  GLuint cubeMap = 0;
+};
+
+// capabilities toggled through enable()/disable()
+enum Capability {
+  DEPTH_TEST,
+  BLEND,
+  CULL_FACE,
+  SCISSOR_TEST,
+  CAPABILITY_COUNT
+};
+
+struct Cache {
+  GLuint activeUnit = 0;
+  TextureUnit units[MAX_TEXTURE_UNITS];
+  bool valid = false;
+
+  GLuint program = UNKNOWN;
+  GLuint vertexArray = UNKNOWN;
+  GLuint arrayBuffer = UNKNOWN;
+  GLuint uniformBuffer = UNKNOWN;
+  GLuint shaderStorageBuffer = UNKNOWN;
+  GLuint drawIndirectBuffer = UNKNOWN;
+  GLuint pixelPackBuffer = UNKNOWN;
+  GLuint pixelUnpackBuffer = UNKNOWN;
+  GLuint framebuffer = UNKNOWN;
+
+  GLuint capabilities[CAPABILITY_COUNT] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+  GLuint depthMask = UNKNOWN;
+  GLuint depthFunc = UNKNOWN;
+  GLuint blendSrc = UNKNOWN, blendDst = UNKNOWN;
+  GLuint polygonMode = UNKNOWN;
+};
+
+inline Cache &cache() {
+  static Cache state;
+  return state;
+}
+
+inline Stats &frameStats() {
+  static Stats stats;
+  return stats;
+}
+
+inline Stats &lastFrameStats() {
+  static Stats stats;
+  return stats;
+}
+
+// counts of the previous complete frame
+inline const Stats &lastFrame() { return lastFrameStats(); }
+
+inline void endFrame() {
+  lastFrameStats() = frameStats();
+  frameStats() = Stats();
+}
+
+// compares the shadow value and records the outcome; true means issue the call
+inline bool change(GLuint &shadow, GLuint value) {
+  if (shadow == value) {
+    frameStats().elided++;
+    return false;
+  }
+  shadow = value;
+  frameStats().issued++;
+  return true;
+}
+
+// forget everything, the next change of each slot always reaches GL
+inline void invalidate() { cache() = Cache(); }
+
+inline GLuint *slot(TextureUnit &unit, GLenum target) {
+  switch (target) {
+  case GL_TEXTURE_2D:
+    return &unit.texture2D;
+  case GL_TEXTURE_2D_ARRAY:
+    return &unit.texture2DArray;
+  case GL_TEXTURE_CUBE_MAP:
+    return &unit.cubeMap;
+  default:
+    return nullptr;
+  }
+}
+
+inline void activeTexture(GLuint unit) {
+  Cache &state = cache();
+  if (state.valid && state.activeUnit == unit) {
+    frameStats().elided++;
+    return;
+  }
+  frameStats().issued++;
+  glActiveTexture(GL_TEXTURE0 + unit);
+  state.activeUnit = unit;
+  if (!state.valid) {
+    // first use: the bindings GL starts with are unknown to us, mark every
+    // slot dirty by using an id no texture can have
+    for (TextureUnit &u : state.units)
+      u.texture2D = u.texture2DArray = u.cubeMap = UNKNOWN;
+    state.valid = true;
+  }
+}
+
+// binds on the currently active unit (texture creation and uploads)
+inline void bindTexture(GLenum target, GLuint texture) {
+  Cache &state = cache();
+  if (!state.valid)
+    activeTexture(0);
+  GLuint *bound = state.activeUnit < MAX_TEXTURE_UNITS
+                      ? slot(state.units[state.activeUnit], target)
+                      : nullptr;
+  if (bound && !change(*bound, texture))
+    return;
+  if (!bound)
+    frameStats().issued++;
+  glBindTexture(target, texture);
+}
+
+// binds `texture` to `unit`, touching glActiveTexture only when it has to
+inline void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+  Cache &state = cache();
+  if (state.valid && unit < MAX_TEXTURE_UNITS) {
+    GLuint *bound = slot(state.units[unit], target);
+    if (bound && *bound == texture) {
+      frameStats().elided++;
+      return;
+    }
+  }
+  activeTexture(unit);
+  bindTexture(target, texture);
+}
+
+inline void useProgram(GLuint program) {
+  if (change(cache().program, program))
+    glUseProgram(program);
+}
+
+inline void bindVertexArray(GLuint vao) {
+  if (change(cache().vertexArray, vao))
+    glBindVertexArray(vao);
+}
+
+// the element array binding belongs to the bound VAO, so it is never cached
+inline void bindBuffer(GLenum target, GLuint buffer) {
+  Cache &state = cache();
+  GLuint *shadow = nullptr;
+  switch (target) {
+  case GL_ARRAY_BUFFER:
+    shadow = &state.arrayBuffer;
+    break;
+  case GL_UNIFORM_BUFFER:
+    shadow = &state.uniformBuffer;
+    break;
+  case GL_SHADER_STORAGE_BUFFER:
+    shadow = &state.shaderStorageBuffer;
+    break;
+  case GL_DRAW_INDIRECT_BUFFER:
+    shadow = &state.drawIndirectBuffer;
+    break;
+  case GL_PIXEL_PACK_BUFFER:
+    shadow = &state.pixelPackBuffer;
+    break;
+  case GL_PIXEL_UNPACK_BUFFER:
+    shadow = &state.pixelUnpackBuffer;
+    break;
+  default:
+    break;
+  }
+  if (shadow && !change(*shadow, buffer))
+    return;
+  if (!shadow)
+    frameStats().issued++;
+  glBindBuffer(target, buffer);
+}
+
+// deleting a bound object silently rebinds 0
+inline void deleteBuffer(GLuint buffer) {
+  Cache &state = cache();
+  for (GLuint *b : {&state.arrayBuffer, &state.uniformBuffer,
+                    &state.shaderStorageBuffer, &state.drawIndirectBuffer,
+                    &state.pixelPackBuffer, &state.pixelUnpackBuffer})
+    if (*b == buffer)
+      *b = 0;
+  glDeleteBuffers(1, &buffer);
+}
+
+inline void bindFramebuffer(GLuint framebuffer) {
+  if (change(cache().framebuffer, framebuffer))
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+inline GLenum capabilityEnum(Capability cap) {
+  switch (cap) {
+  case DEPTH_TEST:
+    return GL_DEPTH_TEST;
+  case BLEND:
+    return GL_BLEND;
+  case CULL_FACE:
+    return GL_CULL_FACE;
+  default:
+    return GL_SCISSOR_TEST;
+  }
+}
+
+inline void setEnabled(Capability cap, bool enabled) {
+  if (!change(cache().capabilities[cap], enabled ? 1 : 0))
+    return;
+  if (enabled)
+    glEnable(capabilityEnum(cap));
+  else
+    glDisable(capabilityEnum(cap));
+}
+
+inline void enable(Capability cap) { setEnabled(cap, true); }
+inline void disable(Capability cap) { setEnabled(cap, false); }
+
+inline void depthMask(bool write) {
+  if (change(cache().depthMask, write ? 1 : 0))
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+inline void depthFunc(GLenum func) {
+  if (change(cache().depthFunc, func))
+    glDepthFunc(func);
+}
+
+inline void blendFunc(GLenum src, GLenum dst) {
+  Cache &state = cache();
+  if (state.blendSrc == src && state.blendDst == dst) {
+    frameStats().elided++;
+    return;
+  }
+  state.blendSrc = src;
+  state.blendDst = dst;
+  frameStats().issued++;
+  glBlendFunc(src, dst);
+}
+
+inline void polygonMode(GLenum mode) {
+  if (change(cache().polygonMode, mode))
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+} // namespace GLState
@@ -0,0 +1,214 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// GPU timings of named, nestable scopes.
+//
+// Each scope writes a GL_TIMESTAMP query with glQueryCounter when it opens
+// and another when it closes, so scopes may nest (GL_TIME_ELAPSED queries
+// cannot). Queries live in a ring of FRAMES per-frame slots: beginFrame()
+// collects the slot recorded FRAMES frames ago and reuses it. When the GPU is
+// still not done with it, that frame's results are dropped instead of
+// waiting, so reading the timings never stalls the pipeline.
+//
+// The last HISTORY frames of samples are kept for summary() (rolling average
+// and percentiles per scope) and writeCsv().
+class GpuProfiler {
+public:
+  static const int FRAMES = 4;
+  static const int HISTORY = 240;
+
+  struct Sample {
+    uint64_t frame;
+    std::string name;
+    int depth; // nesting level, 0 for outermost scopes
+    double ms;
+  };
+
+  struct Summary {
+    std::string name;
+    int depth = 0;
+    double last = 0.0;
+    double average = 0.0;
+    double p50 = 0.0, p95 = 0.0, p99 = 0.0;
+    double max = 0.0;
+  };
+
+  // times the enclosing block
+  class Scope {
+  public:
+    Scope(GpuProfiler &profiler, const char *name) : profiler(profiler) {
+      profiler.begin(name);
+    }
+    ~Scope() { profiler.end(); }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    GpuProfiler &profiler;
+  };
+
+  bool enabled = true;
+
+  // call once per frame before the first scope
+  void beginFrame() {
+    frame++;
+    Slot &slot = slots[frame % FRAMES];
+    if (!slot.scopes.empty())
+      collect(slot);
+    slot.scopes.clear();
+    slot.used = 0;
+    slot.frame = frame;
+    open.clear();
+    recording = enabled;
+  }
+
+  void begin(const std::string &name) {
+    if (!recording)
+      return;
+    Slot &slot = slots[frame % FRAMES];
+    Record record;
+    record.name = name;
+    record.depth = (int)open.size();
+    record.start = stamp(slot);
+    open.push_back((int)slot.scopes.size());
+    slot.scopes.push_back(record);
+  }
+
+  void end() {
+    if (!recording || open.empty())
+      return;
+    Slot &slot = slots[frame % FRAMES];
+    slot.scopes[open.back()].end = stamp(slot);
+    open.pop_back();
+  }
+
+  // samples of the newest frame whose results have arrived
+  const std::vector<Sample> &latest() const { return newest; }
+
+  // milliseconds of `name` in latest(), 0 when it was not recorded
+  double latest(const std::string &name) const {
+    for (const Sample &s : newest)
+      if (s.name == name)
+        return s.ms;
+    return 0.0;
+  }
+
+  // sum of the outermost scopes of latest(), 0 before the first results
+  double frameMs() const {
+    double total = 0.0;
+    for (const Sample &s : newest)
+      if (s.depth == 0)
+        total += s.ms;
+    return total;
+  }
+
+  // frames whose results were dropped because the GPU was FRAMES behind
+  uint64_t dropped() const { return droppedFrames; }
+
+  // one entry per scope of latest(), in the same order, over the history
+  std::vector<Summary> summary() const {
+    std::vector<Summary> result;
+    std::vector<double> values;
+    for (const Sample &current : newest) {
+      values.clear();
+      for (const Sample &s : history)
+        if (s.name == current.name)
+          values.push_back(s.ms);
+      std::sort(values.begin(), values.end());
+      Summary entry;
+      entry.name = current.name;
+      entry.depth = current.depth;
+      entry.last = current.ms;
+      for (double v : values)
+        entry.average += v;
+      entry.average /= (double)values.size();
+      entry.p50 = percentile(values, 0.50);
+      entry.p95 = percentile(values, 0.95);
+      entry.p99 = percentile(values, 0.99);
+      entry.max = values.back();
+      result.push_back(entry);
+    }
+    return result;
+  }
+
+  // every sample of the history as frame,scope,depth,ms rows
+  bool writeCsv(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out)
+      return false;
+    out << "frame,scope,depth,ms\n";
+    for (const Sample &s : history)
+      out << s.frame << ',' << s.name << ',' << s.depth << ',' << s.ms << '\n';
+    return (bool)out;
+  }
+
+private:
+  struct Record {
+    std::string name;
+    int depth = 0;
+    int start = -1, end = -1; // query indices in the slot
+  };
+
+  struct Slot {
+    std::vector<GLuint> queries; // grows to the busiest frame seen
+    int used = 0;
+    uint64_t frame = 0;
+    std::vector<Record> scopes;
+  };
+
+  Slot slots[FRAMES];
+  uint64_t frame = 0;
+  bool recording = false;
+  std::vector<int> open; // scopes still open, innermost last
+  std::vector<Sample> newest;
+  std::deque<Sample> history;
+  uint64_t droppedFrames = 0;
+
+  int stamp(Slot &slot) {
+    if (slot.used == (int)slot.queries.size()) {
+      GLuint query = 0;
+      glGenQueries(1, &query);
+      slot.queries.push_back(query);
+    }
+    glQueryCounter(slot.queries[slot.used], GL_TIMESTAMP);
+    return slot.used++;
+  }
+
+  void collect(const Slot &slot) {
+    // queries complete in order, so the last one covers the whole frame
+    GLint available = 0;
+    glGetQueryObjectiv(slot.queries[slot.used - 1], GL_QUERY_RESULT_AVAILABLE,
+                       &available);
+    if (!available) {
+      droppedFrames++;
+      return;
+    }
+    newest.clear();
+    for (const Record &record : slot.scopes) {
+      if (record.end < 0)
+        continue; // never closed
+      GLuint64 start = 0, end = 0;
+      glGetQueryObjectui64v(slot.queries[record.start], GL_QUERY_RESULT,
+                            &start);
+      glGetQueryObjectui64v(slot.queries[record.end], GL_QUERY_RESULT, &end);
+      Sample sample{slot.frame, record.name, record.depth,
+                    (end - start) / 1.0e6};
+      newest.push_back(sample);
+      history.push_back(sample);
+    }
+    while (!history.empty() && history.front().frame + HISTORY <= slot.frame)
+      history.pop_front();
+  }
+
+  static double percentile(const std::vector<double> &sorted, double q) {
+    size_t index = (size_t)(q * (double)(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+  }
+};
@@ -1,14 +1,63 @@
 #pragma once
+#include "learnopengl/cpu_profiler.hpp"
+#include "learnopengl/entity.h"
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/hiz.hpp"
 #include "learnopengl/shader.h"
+#include "learnopengl/shader_c.h"
+#include "learnopengl/uniform_ring.hpp"
+#include "learnopengl/wind_field.hpp"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
 #include <vector>
 
+// Procedural grass: blade positions come from the instance id, so the field
+// has no instance buffer. Per-blade jitter and scale are read from a small
+// tileable lookup texture and the sway from a WindField.
+//
+// The field is split into TILE x TILE blade tiles; draw() culls each tile
+// against the frustum (and Hi-Z, when given) and issues one instanced draw per
+// visible tile, thinning far tiles by only drawing every stride-th blade in
+// each direction. Near tiles keep stride 1 and therefore all of their blades.
+//
+// With GL 4.3 enableGpuCulling() switches to a GPU-driven path instead:
+// grass_cull.comp tests every blade against the frustum and the same density
+// levels, appends the survivors to an instance buffer and counts them straight
+// into an indirect draw command, so the CPU never touches the blade count.
 class GrassField {
 public:
+  // blades per tile side
+  static const int TILE = 32;
+  // side of the per-blade lookup texture, repeats every HASH_SIZE blades
+  static const int HASH_SIZE = 64;
+  // distance (from the camera to the tile bounds) where each stride starts
+  struct DensityLevel {
+    float distance;
+    int stride;
+  };
+  static constexpr DensityLevel DENSITY_LEVELS[] = {
+      {0.0f, 1}, {25.0f, 2}, {45.0f, 4}, {70.0f, 8}};
+
+  struct Stats {
+    int tiles = 0;
+    int tilesDrawn = 0;
+    int tilesOccluded = 0;
+    long long instances = 0;
+    bool gpuCulled = false; // counts live on the GPU, nothing above is set
+  };
+
+  // the cull pass packs a blade's grid x and z into 16 bits each (aBlade in
+  // grass.vert), so it only takes grids up to this many blades per axis
+  static const int MAX_CULLED_GRID = 65535;
+
   int gridX, gridZ;
   float spacing;
+  Stats stats;
 
   GrassField(int gridX, int gridZ, float spacing)
       : gridX(gridX), gridZ(gridZ), spacing(spacing) {
@@ -19,15 +68,15 @@ public:
     instanceCount = (GLsizei)gridX * gridZ; // Total instances needed
 
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    GLState::bindVertexArray(vao);
 
     glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(),
                  GL_STATIC_DRAW);
 
     glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(unsigned int),
                  idx.data(), GL_STATIC_DRAW);
 
@@ -41,27 +90,107 @@ public:
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
                           (void *)(3 * sizeof(float)));
 
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
+
+    buildTiles();
+    buildBladeHash();
   }
 
-  void draw(Shader shader, float time, glm::mat4 view, glm::mat4 projection) {
-    shader.use();
-    shader.setFloat("uTime", time);
-    shader.setMat4("view", view);
-    shader.setMat4("projection", projection);
+  // Loads the cull pass and allocates its buffers. Returns false, leaving the
+  // tiled path in place, on contexts without compute shaders or for grids
+  // past MAX_CULLED_GRID.
+  bool enableGpuCulling(const char *cullShaderPath) {
+    if (!GLAD_GL_VERSION_4_3)
+      return false;
+    if (gridX > MAX_CULLED_GRID || gridZ > MAX_CULLED_GRID) {
+      std::cout << "ERROR::GRASS:: " << gridX << "x" << gridZ
+                << " blades do not fit the cull pass's 16-bit coordinates"
+                << std::endl;
+      return false;
+    }
+    cullShader = std::make_unique<ComputeShader>(cullShaderPath);
+
+    // one packed grid coordinate per surviving blade
+    glGenBuffers(1, &instanceVBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)gridX * gridZ * sizeof(GLuint),
+                 nullptr, GL_DYNAMIC_COPY);
+    GLState::bindVertexArray(vao);
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)0);
+    glVertexAttribDivisor(3, 1);
+    GLState::bindVertexArray(0);
+
+    glGenBuffers(1, &indirectBuffer);
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand),
+                 nullptr, GL_DYNAMIC_DRAW);
+    return true;
+  }
 
-    shader.setInt("uGridX", gridX);
-    shader.setFloat("uSpacing", spacing);
+  bool gpuCulling() const { return cullShader != nullptr; }
+
+  // view, projection and time come from the ring's Frame block, which must
+  // already be bound
+  void draw(Shader &shader, UniformRing &ring, const Frustum &frustum,
+            const glm::vec3 &cameraPos, const WindField &wind,
+            HiZ *occlusion = nullptr) {
+    PROFILE_ZONE("GrassField::draw");
+    shader.use();
 
     // Calculate the overall field offset once and pass it
-    float offX = -gridX * spacing * 0.5f;
-    float offZ = -gridZ * spacing * 0.5f;
-    shader.setVec2("uOffset", glm::vec2(offX, offZ));
+    DrawBlock block{};
+    block.offset = glm::vec2(-gridX * spacing * 0.5f, -gridZ * spacing * 0.5f);
+    block.windOrigin = wind.origin;
+    block.windSize = wind.size;
+    block.spacing = spacing;
+    GLState::bindTexture(shader.samplerUnit("uBladeHash"), GL_TEXTURE_2D,
+                         bladeHash);
+    GLState::bindTexture(shader.samplerUnit("uWindField"), GL_TEXTURE_2D,
+                         wind.texture);
+    GLState::bindTexture(shader.samplerUnit("uWindGust"), GL_TEXTURE_2D,
+                         wind.gust);
+
+    GLState::polygonMode(GL_FILL);
 
-    glBindVertexArray(vao);
-    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0,
-                            instanceCount);
-    glBindVertexArray(0);
+    stats = Stats();
+    if (cullShader) {
+      cullBlades(frustum, cameraPos);
+      shader.use();
+      block.compacted = 1;
+      UniformRing::Range blockRange = ring.push(block);
+      if (!blockRange.valid())
+        return;
+      ring.bind(UniformRing::DRAW, blockRange);
+      GLState::bindVertexArray(vao);
+      GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+      glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0);
+      stats.gpuCulled = true;
+      return;
+    }
+
+    GLState::bindVertexArray(vao);
+    stats.tiles = (int)tiles.size();
+    for (const Tile &tile : tiles) {
+      if (!tile.bounds.isOnFrustum(frustum))
+        continue;
+      if (occlusion && occlusion->occluded(tile.bounds)) {
+        stats.tilesOccluded++;
+        continue;
+      }
+      int stride = strideFor(tile.bounds, cameraPos);
+      int cols = (tile.cols + stride - 1) / stride;
+      int rows = (tile.rows + stride - 1) / stride;
+      block.tile = glm::ivec4(tile.startX, tile.startZ, cols, stride);
+      UniformRing::Range blockRange = ring.push(block);
+      if (!blockRange.valid())
+        break; // the ring is full for the rest of the frame
+      ring.bind(UniformRing::DRAW, blockRange);
+      glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0,
+                              cols * rows);
+      stats.tilesDrawn++;
+      stats.instances += cols * rows;
+    }
   }
 
 private:
@@ -69,9 +198,43 @@ private:
   // Internal Data
   // ----------------------------------------------------------------------
   GLuint vao = 0, vbo = 0, ebo = 0, instanceVBO = 0;
+  GLuint bladeHash = 0; // RGBA16F: jitter, scale x, scale y, scale z
   GLsizei indexCount = 0;
   GLsizei instanceCount = 0;
 
+  // std140 Draw block of grass.vert
+  struct DrawBlock {
+    glm::ivec4 tile; // first blade x, first blade z, columns drawn, stride
+    glm::vec2 offset;
+    glm::vec2 windOrigin;
+    glm::vec2 windSize;
+    float spacing;
+    int compacted;
+  };
+
+  // GPU-driven path (enableGpuCulling)
+  struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLuint baseVertex;
+    GLuint baseInstance;
+  };
+  std::unique_ptr<ComputeShader> cullShader;
+  GLuint indirectBuffer = 0;
+  // blades further than this are never drawn (the camera far plane)
+  float drawDistance = 100.0f;
+  // bounding sphere of a blade around its scaled root + half height, see the
+  // padding in buildTiles()
+  float bladeRadius = 2.5f;
+
+  struct Tile {
+    int startX, startZ; // first blade of the tile in the full grid
+    int cols, rows;     // blades at stride 1 (edge tiles may be partial)
+    AABB bounds;
+  };
+  std::vector<Tile> tiles;
+
   struct InstanceData {
     float x, y, z;
     float phase;
@@ -104,6 +267,114 @@ private:
            2, 0, 5, 0, 3, 5};
   }
 
+  // ----------------------------------------------------------------------
+  // Build tiles
+  // ----------------------------------------------------------------------
+  // grass.vert multiplies the whole world position by the blade's random
+  // scale (x/z in [0.5, 1.5], y in [0.8, 1.2]), so a tile covers the range
+  // its blades can be scaled into, not just its own cells
+  static void scaledRange(float lo, float hi, float minScale, float maxScale,
+                          float &outLo, float &outHi) {
+    outLo = std::min(lo * minScale, lo * maxScale);
+    outHi = std::max(hi * minScale, hi * maxScale);
+  }
+
+  void buildTiles() {
+    // jitter (0.1), blade width (0.2) and the largest sway (0.9)
+    const float pad = 1.2f;
+    const float bladeHeight = 1.5f;
+    float offX = -gridX * spacing * 0.5f;
+    float offZ = -gridZ * spacing * 0.5f;
+
+    tiles.clear();
+    for (int z = 0; z < gridZ; z += TILE) {
+      for (int x = 0; x < gridX; x += TILE) {
+        int cols = std::min(TILE, gridX - x);
+        int rows = std::min(TILE, gridZ - z);
+        glm::vec3 min, max;
+        scaledRange(offX + x * spacing - pad,
+                    offX + (x + cols - 1) * spacing + pad, 0.5f, 1.5f, min.x,
+                    max.x);
+        scaledRange(offZ + z * spacing - pad,
+                    offZ + (z + rows - 1) * spacing + pad, 0.5f, 1.5f, min.z,
+                    max.z);
+        scaledRange(0.0f, bladeHeight, 0.8f, 1.2f, min.y, max.y);
+        tiles.push_back({x, z, cols, rows, AABB(min, max)});
+      }
+    }
+  }
+
+  // resets the command, runs the cull pass and makes its writes visible to
+  // the indirect draw and the instance attribute fetch
+  void cullBlades(const Frustum &frustum, const glm::vec3 &cameraPos) {
+    DrawElementsIndirectCommand command = {(GLuint)indexCount, 0, 0, 0, 0};
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+
+    const Plane *faces[6] = {&frustum.leftFace, &frustum.rightFace,
+                             &frustum.topFace,  &frustum.bottomFace,
+                             &frustum.nearFace, &frustum.farFace};
+    glm::vec4 planes[6];
+    for (int i = 0; i < 6; i++)
+      planes[i] = glm::vec4(faces[i]->normal, faces[i]->distance);
+
+    cullShader->use();
+    cullShader->setIVec2("uGrid", glm::ivec2(gridX, gridZ));
+    cullShader->setFloat("uSpacing", spacing);
+    cullShader->setVec2("uOffset", glm::vec2(-gridX * spacing * 0.5f,
+                                             -gridZ * spacing * 0.5f));
+    glUniform4fv(glGetUniformLocation(cullShader->ID, "uPlanes"), 6,
+                 &planes[0][0]);
+    cullShader->setVec3("uCameraPos", cameraPos);
+    cullShader->setVec4("uLodDistance",
+                        glm::vec4(DENSITY_LEVELS[1].distance,
+                                  DENSITY_LEVELS[2].distance,
+                                  DENSITY_LEVELS[3].distance, drawDistance));
+    cullShader->setFloat("uRadius", bladeRadius);
+    cullShader->setInt("uBladeHash", 0);
+    GLState::bindTexture(0, GL_TEXTURE_2D, bladeHash);
+
+    // glBindBufferBase also sets the generic binding, keep the cache in step
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceVBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceVBO);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, indirectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, indirectBuffer);
+    glDispatchCompute((gridX + 15) / 16, (gridZ + 15) / 16, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT |
+                    GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+  }
+
+  // same distributions grass.vert used to derive from its sine hash, fixed
+  // seed so the field looks the same every run
+  void buildBladeHash() {
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<float> texels(HASH_SIZE * HASH_SIZE * 4);
+    for (size_t i = 0; i < texels.size(); i += 4) {
+      texels[i + 0] = unit(rng) * 0.1f;        // jitter
+      texels[i + 1] = 1.0f + 0.5f * unit(rng); // scale x
+      texels[i + 2] = 1.0f + 0.2f * unit(rng); // scale y
+      texels[i + 3] = 1.0f + 0.5f * unit(rng); // scale z
+    }
+    glGenTextures(1, &bladeHash);
+    GLState::bindTexture(GL_TEXTURE_2D, bladeHash);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, HASH_SIZE, HASH_SIZE, 0,
+                 GL_RGBA, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+
+  static int strideFor(const AABB &bounds, const glm::vec3 &cameraPos) {
+    glm::vec3 closest = glm::clamp(cameraPos, bounds.center - bounds.extents,
+                                   bounds.center + bounds.extents);
+    float distance = glm::length(closest - cameraPos);
+    int stride = 1;
+    for (const DensityLevel &level : DENSITY_LEVELS)
+      if (distance >= level.distance)
+        stride = level.stride;
+    return stride;
+  }
+
   // ----------------------------------------------------------------------
   // Build instances
   // ----------------------------------------------------------------------
@@ -131,7 +402,7 @@ private:
   //   instanceCount = (GLsizei)data.size();
 
   //   glGenBuffers(1, &instanceVBO);
-  //   glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+  //   GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
   //   glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(InstanceData),
   //                data.data(), GL_STATIC_DRAW);
   // }
@@ -4,6 +4,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp> // Required for glm::value_ptr
 #include <iostream>
+#include <learnopengl/gl_state.hpp>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform_ring.hpp>
 #include <string>
 
 #include "stb_image.h"
@@ -20,35 +23,25 @@ public:
     textureID = loadTexture(texturePath);
   }
 
-  // The primary drawing function
-  void Draw(unsigned int shaderID, const glm::mat4 &view,
-            const glm::mat4 &projection) {
-    glUseProgram(shaderID);
-
+  // The primary drawing function; view and projection come from the ring's
+  // Frame block, which must already be bound
+  void Draw(Shader &shader, UniformRing &ring) {
     // Use an identity matrix for the model since the ground is centered
-    glm::mat4 model = glm::mat4(1.0f);
-
-    // Set Transformation Uniforms (Assuming the shader has these uniform names)
-    glUniformMatrix4fv(glGetUniformLocation(shaderID, "model"), 1, GL_FALSE,
-                       glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shaderID, "view"), 1, GL_FALSE,
-                       glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(shaderID, "projection"), 1,
-                       GL_FALSE, glm::value_ptr(projection));
-
-    // Set Custom Ground Uniforms
-    glUniform1f(glGetUniformLocation(shaderID, "scaleFactor"), scaleFactor);
-    glUniform1f(glGetUniformLocation(shaderID, "tileFactor"), tileFactor);
+    DrawBlock block{glm::mat4(1.0f), scaleFactor, tileFactor};
+    UniformRing::Range blockRange = ring.push(block);
+    if (!blockRange.valid())
+      return; // the ring is full this frame
+    shader.use();
+    ring.bind(UniformRing::DRAW, blockRange);
 
     // Bind Texture (Set sampler to use texture unit 0)
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glUniform1i(glGetUniformLocation(shaderID, "groundTexture"), 0);
+    GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
+    shader.setInt("groundTexture", 0);
 
     // Draw the mesh
-    glBindVertexArray(VAO);
+    GLState::polygonMode(GL_FILL);
+    GLState::bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
   }
 
 private:
@@ -58,6 +51,14 @@ private:
   float scaleFactor;
   float tileFactor;
 
+  // std140 Draw block of ground.vert
+  struct DrawBlock {
+    glm::mat4 model;
+    float scaleFactor;
+    float tileFactor;
+    float pad[2];
+  };
+
   // Helper functions
   void setupMesh() {
     // Defines a 2x2 quad in the XZ plane (Y=0)
@@ -72,9 +73,9 @@ private:
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
 
-    glBindVertexArray(VAO);
+    GLState::bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     // Position attribute (layout location 0)
@@ -87,7 +88,7 @@ private:
                           (void *)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
   }
   unsigned int loadTexture(const std::string &path) {
     unsigned int texture;
@@ -102,7 +103,7 @@ private:
       if (nrChannels == 1)
         format = GL_RED;
 
-      glBindTexture(GL_TEXTURE_2D, texture);
+      GLState::bindTexture(GL_TEXTURE_2D, texture);
       glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
                    GL_UNSIGNED_BYTE, data);
       glGenerateMipmap(GL_TEXTURE_2D);
@@ -0,0 +1,215 @@
+#pragma once
+#include "learnopengl/entity.h"
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/shader_c.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Hierarchical-Z occlusion culling against the previous frame's depth.
+//
+// build() reduces the scene depth into a max-depth mip pyramid on the GPU
+// (hiz_reduce.comp) and starts an asynchronous readback of one coarse level
+// through a pixel pack buffer. A later frame picks that level up once its
+// fence has signalled, together with the view-projection it was rendered
+// with, and occluded() tests world-space boxes against it on the CPU: a box
+// is hidden when its nearest depth is behind the farthest depth of every
+// texel its screen rectangle covers.
+//
+// The data is one to two frames old. Boxes that reach behind the camera or
+// off screen always count as visible, and readbacks older than MAX_AGE frames
+// are ignored so fast camera moves do not cull things that just came into
+// view. Needs GL 4.3; without it nothing is ever reported occluded.
+class HiZ {
+public:
+  // coarsest level read back is the first one at most this wide
+  static const int READBACK_WIDTH = 128;
+  static const int MAX_AGE = 3;
+
+  struct Stats {
+    unsigned int tested = 0;
+    unsigned int occluded = 0;
+  };
+
+  Stats stats;
+
+  bool enable(const char *reduceShaderPath) {
+    if (!GLAD_GL_VERSION_4_3)
+      return false;
+    reduce = std::make_unique<ComputeShader>(reduceShaderPath);
+    glGenBuffers(2, pbo);
+    return true;
+  }
+
+  bool enabled() const { return reduce != nullptr; }
+
+  // call once per frame before any occluded() test: adopts the newest
+  // finished readback and resets the counters. Both slots can finish in the
+  // same frame, and a readback older than the adopted copy is dropped.
+  void beginFrame() {
+    stats = Stats();
+    age++;
+    if (!reduce)
+      return;
+    int newest = -1;
+    for (int i = 0; i < 2; i++) {
+      Readback &r = pending[i];
+      if (!r.fence)
+        continue;
+      GLenum status = glClientWaitSync(r.fence, 0, 0);
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        continue;
+      glDeleteSync(r.fence);
+      r.fence = 0;
+      if (r.serial > adopted &&
+          (newest < 0 || r.serial > pending[newest].serial))
+        newest = i;
+    }
+    if (newest >= 0) {
+      const Readback &r = pending[newest];
+      GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, pbo[newest]);
+      const float *data = (const float *)glMapBufferRange(
+          GL_PIXEL_PACK_BUFFER, 0, r.width * r.height * sizeof(float),
+          GL_MAP_READ_BIT);
+      if (data) {
+        depth.assign(data, data + r.width * r.height);
+        width = r.width;
+        height = r.height;
+        viewProjection = r.viewProjection;
+        adopted = r.serial;
+        age = (int)(builds - r.serial); // readbacks queued after it
+      }
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+  }
+
+  // builds the pyramid from `depthTexture` (width x height, rendered with
+  // `viewProj`) and queues the readback
+  void build(GLuint depthTexture, int w, int h, const glm::mat4 &viewProj) {
+    if (!reduce)
+      return;
+    allocate(std::max(1, w / 2), std::max(1, h / 2));
+
+    reduce->use();
+    reduce->setInt("uSrc", 0);
+    for (int level = 0; level < levels; level++) {
+      GLuint src = level == 0 ? depthTexture : pyramid;
+      reduce->setInt("uSrcLevel", level == 0 ? 0 : level - 1);
+      GLState::bindTexture(0, GL_TEXTURE_2D, src);
+      glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY,
+                         GL_R32F);
+      int lw = std::max(1, baseWidth >> level);
+      int lh = std::max(1, baseHeight >> level);
+      glDispatchCompute((lw + 7) / 8, (lh + 7) / 8, 1);
+      glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                      GL_TEXTURE_UPDATE_BARRIER_BIT);
+    }
+
+    // a slot whose previous readback is still in flight is skipped this frame
+    Readback &r = pending[next];
+    if (r.fence)
+      return;
+    r.width = std::max(1, baseWidth >> readbackLevel);
+    r.height = std::max(1, baseHeight >> readbackLevel);
+    r.viewProjection = viewProj;
+    r.serial = ++builds;
+    GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, pbo[next]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, r.width * r.height * sizeof(float),
+                 nullptr, GL_STREAM_READ);
+    GLState::bindTexture(0, GL_TEXTURE_2D, pyramid);
+    glGetTexImage(GL_TEXTURE_2D, readbackLevel, GL_RED, GL_FLOAT, (void *)0);
+    GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next = 1 - next;
+  }
+
+  // true when `box` is certainly hidden behind last frame's depth
+  bool occluded(const AABB &box) {
+    stats.tested++;
+    if (depth.empty() || age > MAX_AGE)
+      return false;
+
+    glm::vec2 lo(1.0f), hi(-1.0f);
+    float nearest = 1.0f;
+    for (const glm::vec3 &corner : box.getVertice()) {
+      glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+      if (clip.w <= 1e-4f)
+        return false; // crosses the camera plane
+      glm::vec3 ndc = glm::vec3(clip) / clip.w;
+      lo = glm::min(lo, glm::vec2(ndc));
+      hi = glm::max(hi, glm::vec2(ndc));
+      nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+    lo = glm::clamp(lo, -1.0f, 1.0f);
+    hi = glm::clamp(hi, -1.0f, 1.0f);
+    if (lo.x >= hi.x || lo.y >= hi.y)
+      return false;
+
+    int x0 = (int)std::floor((lo.x * 0.5f + 0.5f) * width);
+    int y0 = (int)std::floor((lo.y * 0.5f + 0.5f) * height);
+    int x1 = std::min(width - 1, (int)std::floor((hi.x * 0.5f + 0.5f) * width));
+    int y1 =
+        std::min(height - 1, (int)std::floor((hi.y * 0.5f + 0.5f) * height));
+    for (int y = y0; y <= y1; y++)
+      for (int x = x0; x <= x1; x++)
+        if (depth[y * width + x] >= nearest)
+          return false;
+    stats.occluded++;
+    return true;
+  }
+
+private:
+  struct Readback {
+    GLsync fence = 0;
+    int width = 0, height = 0;
+    glm::mat4 viewProjection{1.0f};
+    uint64_t serial = 0; // which build() queued it, counting from 1
+  };
+
+  std::unique_ptr<ComputeShader> reduce;
+  GLuint pyramid = 0;
+  int baseWidth = 0, baseHeight = 0, levels = 0, readbackLevel = 0;
+  GLuint pbo[2] = {0, 0};
+  Readback pending[2];
+  int next = 0;
+  uint64_t builds = 0; // readbacks queued so far
+
+  // newest CPU copy
+  std::vector<float> depth;
+  int width = 0, height = 0;
+  glm::mat4 viewProjection{1.0f};
+  uint64_t adopted = 0; // serial of the readback in depth
+  int age = MAX_AGE + 1;
+
+  void allocate(int w, int h) {
+    if (pyramid && w == baseWidth && h == baseHeight)
+      return;
+    if (pyramid) {
+      glDeleteTextures(1, &pyramid);
+      GLState::invalidate();
+    }
+    baseWidth = w;
+    baseHeight = h;
+    levels = 1;
+    while ((std::max(w, h) >> levels) > 0)
+      levels++;
+    readbackLevel = 0;
+    while ((baseWidth >> readbackLevel) > READBACK_WIDTH &&
+           readbackLevel < levels - 1)
+      readbackLevel++;
+
+    glGenTextures(1, &pyramid);
+    GLState::bindTexture(GL_TEXTURE_2D, pyramid);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, w, h);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // a resize invalidates whatever is in flight or cached
+    depth.clear();
+  }
+};
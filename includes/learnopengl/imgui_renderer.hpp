@@ -0,0 +1,185 @@
+#pragma once
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/shader.h"
+#include "learnopengl/uniform_ring.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <imgui.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Draws ImGui's output on the render thread without touching the ImGui
+// context.
+//
+// The context belongs to the main thread, which already runs the next
+// ImGui::NewFrame() while the render thread replays the previous frame. The
+// stock OpenGL backend reads the context (IO, backend data, font atlas)
+// while it draws, so it cannot run there. Instead record() copies a frame's
+// ImDrawData into a Frame on the main thread, with texture ids resolved and
+// display size and scale included, and render() only reads that Frame. The
+// vertices and indices go through the UniformRing like ImmediateRenderer's.
+class ImGuiRenderer {
+public:
+  struct Command {
+    glm::vec4 clip; // x0, y0, x1, y1 in display coordinates
+    GLuint texture;
+    GLuint elementCount;
+    GLuint indexOffset;
+    GLint vertexOffset;
+  };
+
+  struct List {
+    std::vector<ImDrawVert> vertices;
+    std::vector<ImDrawIdx> indices;
+    std::vector<Command> commands;
+  };
+
+  // one frame of ImGui output; lists keep their capacity across frames
+  struct Frame {
+    glm::vec2 displayPos{0.0f};
+    glm::vec2 displaySize{0.0f};
+    glm::vec2 framebufferScale{1.0f};
+    std::vector<List> lists;
+    size_t listCount = 0;
+  };
+
+  // Builds the font atlas texture and takes the renderer role in the
+  // context. Call on the main thread while it still has the GL context,
+  // after the fonts were added.
+  void init() {
+    ImGuiIO &io = ImGui::GetIO();
+    io.BackendRendererName = "hk_imgui_renderer";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+
+    unsigned char *pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    glGenTextures(1, &fontTexture);
+    GLState::bindTexture(GL_TEXTURE_2D, fontTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, pixels);
+    io.Fonts->SetTexID((ImTextureID)(intptr_t)fontTexture);
+
+    glGenVertexArrays(1, &vao);
+  }
+
+  // copies `data` (from ImGui::GetDrawData()) into `frame`; main thread
+  static void record(const ImDrawData *data, Frame &frame) {
+    frame.listCount = 0;
+    if (!data)
+      return;
+    frame.displayPos = glm::vec2(data->DisplayPos.x, data->DisplayPos.y);
+    frame.displaySize = glm::vec2(data->DisplaySize.x, data->DisplaySize.y);
+    frame.framebufferScale =
+        glm::vec2(data->FramebufferScale.x, data->FramebufferScale.y);
+    if (frame.lists.size() < (size_t)data->CmdListsCount)
+      frame.lists.resize(data->CmdListsCount);
+    for (int n = 0; n < data->CmdListsCount; n++) {
+      const ImDrawList *source = data->CmdLists[n];
+      List &list = frame.lists[frame.listCount++];
+      list.vertices.assign(source->VtxBuffer.begin(), source->VtxBuffer.end());
+      list.indices.assign(source->IdxBuffer.begin(), source->IdxBuffer.end());
+      list.commands.clear();
+      for (const ImDrawCmd &cmd : source->CmdBuffer) {
+        // the game registers no draw callbacks; ResetRenderState needs none
+        if (cmd.UserCallback)
+          continue;
+        list.commands.push_back(
+            {glm::vec4(cmd.ClipRect.x, cmd.ClipRect.y, cmd.ClipRect.z,
+                       cmd.ClipRect.w),
+             (GLuint)(intptr_t)cmd.GetTexID(), cmd.ElemCount, cmd.IdxOffset,
+             (GLint)cmd.VtxOffset});
+      }
+    }
+  }
+
+  // draws `frame` (imgui.vert/.frag) into the bound framebuffer
+  void render(const Frame &frame, Shader &shader, UniformRing &ring) {
+    int width = (int)(frame.displaySize.x * frame.framebufferScale.x);
+    int height = (int)(frame.displaySize.y * frame.framebufferScale.y);
+    if (frame.listCount == 0 || width <= 0 || height <= 0)
+      return;
+
+    // display coordinates, y down, to clip space
+    glm::vec2 min = frame.displayPos;
+    glm::vec2 max = frame.displayPos + frame.displaySize;
+    UniformRing::Range blockRange =
+        ring.push(DrawBlock{glm::ortho(min.x, max.x, max.y, min.y)});
+    if (!blockRange.valid())
+      return;
+    shader.use();
+    ring.bind(UniformRing::DRAW, blockRange);
+    GLuint unit = (GLuint)shader.samplerUnit("Texture");
+
+    glViewport(0, 0, width, height);
+    GLState::enable(GLState::BLEND);
+    GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::disable(GLState::CULL_FACE);
+    GLState::disable(GLState::DEPTH_TEST);
+    GLState::enable(GLState::SCISSOR_TEST);
+    GLState::polygonMode(GL_FILL);
+    GLState::bindVertexArray(vao);
+
+    for (size_t n = 0; n < frame.listCount; n++) {
+      const List &list = frame.lists[n];
+      UniformRing::Range vertices = ring.push(
+          list.vertices.data(), list.vertices.size() * sizeof(ImDrawVert));
+      UniformRing::Range indices = ring.push(
+          list.indices.data(), list.indices.size() * sizeof(ImDrawIdx));
+      if (!vertices.valid() || !indices.valid())
+        continue;
+      GLState::bindBuffer(GL_ARRAY_BUFFER, ring.id());
+      GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ring.id());
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(
+          0, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert),
+          (void *)(vertices.offset + offsetof(ImDrawVert, pos)));
+      glEnableVertexAttribArray(1);
+      glVertexAttribPointer(
+          1, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert),
+          (void *)(vertices.offset + offsetof(ImDrawVert, uv)));
+      glEnableVertexAttribArray(2);
+      glVertexAttribPointer(
+          2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert),
+          (void *)(vertices.offset + offsetof(ImDrawVert, col)));
+
+      for (const Command &cmd : list.commands) {
+        // to framebuffer pixels, origin at the bottom-left for glScissor
+        glm::vec2 lo = (glm::vec2(cmd.clip.x, cmd.clip.y) - min) *
+                       frame.framebufferScale;
+        glm::vec2 hi = (glm::vec2(cmd.clip.z, cmd.clip.w) - min) *
+                       frame.framebufferScale;
+        if (hi.x <= lo.x || hi.y <= lo.y)
+          continue;
+        glScissor((GLint)lo.x, (GLint)(height - hi.y), (GLsizei)(hi.x - lo.x),
+                  (GLsizei)(hi.y - lo.y));
+        GLState::bindTexture(unit, GL_TEXTURE_2D, cmd.texture);
+        glDrawElementsBaseVertex(
+            GL_TRIANGLES, (GLsizei)cmd.elementCount,
+            sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+            (void *)(indices.offset + cmd.indexOffset * sizeof(ImDrawIdx)),
+            cmd.vertexOffset);
+      }
+    }
+
+    GLState::disable(GLState::SCISSOR_TEST);
+    GLState::disable(GLState::BLEND);
+    GLState::enable(GLState::DEPTH_TEST);
+  }
+
+private:
+  // std140 Draw block of imgui.vert
+  struct DrawBlock {
+    glm::mat4 projection;
+  };
+
+  GLuint fontTexture = 0;
+  GLuint vao = 0;
+};
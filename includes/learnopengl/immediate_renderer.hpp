@@ -0,0 +1,157 @@
+#pragma once
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/shader.h"
+#include "learnopengl/uniform_ring.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Immediate-mode lines, boxes and quads for the HUD and debug views.
+//
+// Callers append primitives anywhere during the frame instead of owning
+// buffers and issuing draws of their own. Vertices collect per layer and
+// primitive type, and flush() pushes each list into the UniformRing (the
+// same buffer the per-draw constants and indirect commands live in, so
+// persistently mapped with GL 4.4) and draws it with a single glDrawArrays:
+// one draw for all lines and one for all triangles of a layer, however many
+// boxes and bars were added.
+//
+// Layers differ in space and depth mode:
+//   WORLD         world space, depth tested against the scene
+//   WORLD_ON_TOP  world space, drawn over everything
+//   SCREEN        pixels, origin at the bottom-left corner
+// None of them writes depth. Colors are packed to 8 bits per channel.
+class ImmediateRenderer {
+public:
+  enum Layer { WORLD, WORLD_ON_TOP, SCREEN, LAYERS };
+
+  struct Stats {
+    int lines = 0;
+    int triangles = 0;
+    int draws = 0;
+  };
+
+  Stats stats;
+
+  // clears the counters and whatever a skipped flush left behind
+  void begin() {
+    for (Batch &batch : batches) {
+      batch.lines.clear();
+      batch.triangles.clear();
+    }
+    stats = Stats();
+  }
+
+  void line(const glm::vec3 &a, const glm::vec3 &b, const glm::vec4 &color,
+            Layer layer = WORLD) {
+    uint32_t packed = glm::packUnorm4x8(color);
+    std::vector<Vertex> &lines = batches[layer].lines;
+    lines.push_back({a, packed});
+    lines.push_back({b, packed});
+  }
+
+  // the edges of the box [`min`, `max`] transformed by `model`
+  void box(const glm::mat4 &model, const glm::vec3 &min, const glm::vec3 &max,
+           const glm::vec4 &color, Layer layer = WORLD) {
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+      glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y,
+                       i & 4 ? max.z : min.z);
+      corners[i] = glm::vec3(model * glm::vec4(corner, 1.0f));
+    }
+    // corners differing in one bit share an edge
+    static const int edges[12][2] = {{0, 1}, {2, 3}, {4, 5}, {6, 7},
+                                     {0, 2}, {1, 3}, {4, 6}, {5, 7},
+                                     {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+    for (const auto &edge : edges)
+      line(corners[edge[0]], corners[edge[1]], color, layer);
+  }
+
+  // filled rectangle in pixels
+  void quad(const glm::vec2 &min, const glm::vec2 &max,
+            const glm::vec4 &color) {
+    uint32_t packed = glm::packUnorm4x8(color);
+    std::vector<Vertex> &triangles = batches[SCREEN].triangles;
+    Vertex a{{min.x, min.y, 0.0f}, packed}, b{{max.x, min.y, 0.0f}, packed},
+        c{{max.x, max.y, 0.0f}, packed}, d{{min.x, max.y, 0.0f}, packed};
+    triangles.insert(triangles.end(), {a, b, c, c, d, a});
+  }
+
+  // Draws and clears `layer` with `shader` (immediate.vert/.frag).
+  // `transform` maps the layer's space to clip space: projection * view for
+  // the world layers, an orthographic projection for SCREEN. Leaves the
+  // depth test as the layer needs it.
+  void flush(Layer layer, Shader &shader, UniformRing &ring,
+             const glm::mat4 &transform) {
+    Batch &batch = batches[layer];
+    if (batch.lines.empty() && batch.triangles.empty())
+      return;
+    if (vao == 0)
+      glGenVertexArrays(1, &vao);
+
+    UniformRing::Range blockRange = ring.push(DrawBlock{transform});
+    if (!blockRange.valid()) {
+      batch.lines.clear();
+      batch.triangles.clear();
+      return;
+    }
+    shader.use();
+    ring.bind(UniformRing::DRAW, blockRange);
+    GLState::setEnabled(GLState::DEPTH_TEST, layer == WORLD);
+    GLState::depthMask(false);
+    GLState::polygonMode(GL_FILL);
+    GLState::bindVertexArray(vao);
+    draw(batch.lines, GL_LINES, ring);
+    draw(batch.triangles, GL_TRIANGLES, ring);
+    GLState::depthMask(true);
+
+    stats.lines += (int)batch.lines.size() / 2;
+    stats.triangles += (int)batch.triangles.size() / 3;
+    batch.lines.clear();
+    batch.triangles.clear();
+  }
+
+private:
+  struct Vertex {
+    glm::vec3 position;
+    uint32_t color; // RGBA8
+  };
+
+  struct Batch {
+    std::vector<Vertex> lines;
+    std::vector<Vertex> triangles;
+  };
+
+  // std140 Draw block of immediate.vert
+  struct DrawBlock {
+    glm::mat4 transform;
+  };
+
+  Batch batches[LAYERS];
+  GLuint vao = 0;
+
+  void draw(const std::vector<Vertex> &vertices, GLenum mode,
+            UniformRing &ring) {
+    if (vertices.empty())
+      return;
+    UniformRing::Range range =
+        ring.push(vertices.data(), vertices.size() * sizeof(Vertex));
+    if (!range.valid())
+      return;
+    // the ring's offsets need not be multiples of the vertex size, so the
+    // attributes point at the range instead of using glDrawArrays' first
+    GLState::bindBuffer(GL_ARRAY_BUFFER, ring.id());
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)range.offset);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                          (void *)(range.offset + offsetof(Vertex, color)));
+    glDrawArrays(mode, 0, (GLsizei)vertices.size());
+    stats.draws++;
+  }
+};
@@ -0,0 +1,167 @@
+#pragma once
+#include "learnopengl/cpu_profiler.hpp"
+#include "learnopengl/culling.hpp"
+#include "learnopengl/entity.h"
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/hiz.hpp"
+#include "learnopengl/model_animation.h"
+#include "learnopengl/shader.h"
+#include "learnopengl/shader_variants.hpp"
+#include "learnopengl/texture_streamer.hpp"
+#include "learnopengl/uniform_ring.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Instanced skinned rendering for many actors sharing one Model.
+//
+// Every frame the actors add themselves with their world matrix and bone
+// palette. Palettes are appended to one shader storage buffer (binding 0),
+// trimmed to the model's bone count, and each visible (mesh, actor) pair
+// becomes an Instance record in a second one (binding 1) holding the mesh's
+// world matrix, the offset of the actor's palette and its hit flag. flush()
+// then draws each mesh, one skin group at a time, with an instanced draw;
+// the INSTANCED variant of the model shader (texturedModel.vert) finds its
+// record at instanceBase + gl_InstanceID, instanceBase coming from the
+// draw's ObjectBlock in the UniformRing.
+//
+// Culling is per actor and per mesh, exactly like Culling::submit. Needs GL
+// 4.3 for the storage buffers; enable() returns false without it and the
+// actors should keep going through the RenderQueue.
+class InstancedModel {
+public:
+  struct Stats {
+    int actors = 0;    // added this frame
+    int instances = 0; // visible (mesh, actor) pairs
+    int draws = 0;
+  };
+
+  Stats stats;
+
+  InstancedModel(std::shared_ptr<Model> model, ShaderVariants &shaders)
+      : model(std::move(model)), shaders(&shaders) {}
+
+  bool enable() {
+    if (!GLAD_GL_VERSION_4_3)
+      return false;
+    glGenBuffers(1, &paletteBuffer);
+    glGenBuffers(1, &instanceBuffer);
+    batches.resize(model->meshes.size());
+    return true;
+  }
+
+  bool enabled() const { return paletteBuffer != 0; }
+
+  void begin() {
+    palettes.clear();
+    for (std::vector<Instance> &batch : batches)
+      batch.clear();
+    stats = Stats();
+  }
+
+  // Adds one actor. Meshes outside `frustum` (or hidden according to
+  // `occlusion`) are skipped, and an actor with nothing visible does not
+  // upload its palette.
+  void add(const glm::mat4 &objectModel, IAnimator &animator,
+           const std::vector<glm::mat4> &bones, bool isHit,
+           const Frustum &frustum, HiZ *occlusion = nullptr) {
+    stats.actors++;
+    uint32_t palette = UINT32_MAX;
+    Culling::visibleMeshes(
+        *model, objectModel, animator, bones, frustum, occlusion,
+        [&](unsigned int i, const glm::mat4 &transform) {
+          if (palette == UINT32_MAX)
+            palette = appendPalette(bones);
+          batches[i].push_back({transform, palette, isHit ? 1u : 0u, {0, 0}});
+          TextureStreamer::instance().touch(model->meshes[i], transform);
+        });
+  }
+
+  // the ring's Frame block must already be bound
+  void flush(UniformRing &ring) {
+    PROFILE_ZONE("InstancedModel::flush");
+    if (!enabled())
+      return;
+
+    // one contiguous range of records per mesh
+    static std::vector<Instance> records;
+    records.clear();
+    for (const std::vector<Instance> &batch : batches)
+      records.insert(records.end(), batch.begin(), batch.end());
+    if (records.empty())
+      return;
+    stats.instances = (int)records.size();
+
+    // orphaned every frame so the driver never waits on last frame's draws
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, paletteBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 palettes.size() * sizeof(glm::mat4), palettes.data(),
+                 GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, paletteBuffer);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(Instance),
+                 records.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, instanceBuffer);
+
+    GLState::polygonMode(GL_FILL);
+
+    int base = 0;
+    for (unsigned int i = 0; i < batches.size(); i++) {
+      GLsizei count = (GLsizei)batches[i].size();
+      if (count == 0)
+        continue;
+      Mesh &mesh = model->meshes[i];
+      // the hit flash stays per instance, so only the mesh and its skin
+      // groups pick the variants
+      for (const Mesh::SkinGroup &group : mesh.skinGroups) {
+        Shader &shader = shaders->get(ShaderFeature::INSTANCED |
+                                      mesh.shaderFeatures() | group.features);
+        shader.use();
+        for (const Mesh::MaterialBinding &binding :
+             mesh.materialFor(shader).bindings)
+          GLState::bindTexture(binding.unit, binding.target, binding.texture);
+        ObjectBlock block{glm::mat4(1.0f), 0, mesh.diffuseLayer, base,
+                          group.bone};
+        UniformRing::Range blockRange = ring.push(block);
+        if (!blockRange.valid())
+          continue; // the ring is full, the bound block is someone else's
+        ring.bind(UniformRing::DRAW, blockRange);
+        GLState::bindVertexArray(mesh.VAO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, group.indexCount,
+                                          GL_UNSIGNED_INT,
+                                          mesh.indexOffset(group), count,
+                                          mesh.baseVertex);
+        stats.draws++;
+      }
+      base += count;
+    }
+  }
+
+private:
+  // std430 layout of the shader's Instance struct (80 bytes)
+  struct Instance {
+    glm::mat4 model;
+    uint32_t palette;
+    uint32_t hit;
+    uint32_t pad[2];
+  };
+
+  std::shared_ptr<Model> model;
+  ShaderVariants *shaders;
+  GLuint paletteBuffer = 0;
+  GLuint instanceBuffer = 0;
+  std::vector<glm::mat4> palettes;
+  std::vector<std::vector<Instance>> batches; // per mesh
+
+  uint32_t appendPalette(const std::vector<glm::mat4> &bones) {
+    // only the bones the model actually has; the animator keeps 100
+    size_t used = std::min(bones.size(),
+                           (size_t)std::max(1, model->GetBoneCount()));
+    uint32_t offset = (uint32_t)palettes.size();
+    palettes.insert(palettes.end(), bones.begin(), bones.begin() + used);
+    return offset;
+  }
+};
@@ -9,10 +9,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/gl_state.hpp>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.hpp>
+#include <learnopengl/uniform_ring.hpp>
 
+#include <algorithm>
 #include <string>
 #include <sys/types.h>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -52,7 +57,8 @@ struct Material {
   std::unordered_map<aiTextureType, Texture> textures;
 };
 
-struct AABB {
+// bind-pose bounds in mesh space, from assimp's aiProcess_GenBoundingBoxes
+struct MeshAABB {
   glm::vec3 mMin;
   glm::vec3 mMax;
 };
@@ -63,17 +69,38 @@ public:
   vector<Vertex> vertices;
   vector<unsigned int> indices;
   vector<Texture> textures;
-  unsigned int VAO;
+  unsigned int VAO = 0;
   std::string nodeName;
   bool hasBones;
   string name;
   Material material;
-  AABB mAABB;
+  MeshAABB mAABB;
+  // bones that move at least one vertex, and whether some vertex has no
+  // weights at all (the shader leaves those in bind pose). Culling bounds a
+  // skinned mesh by its box under each of these bones.
+  vector<int> influencingBones;
+  bool hasUnweightedVertices = false;
+
+  // A range of indices whose triangles need the same skinning variant.
+  // Skinned meshes are split by the most bones any vertex of a triangle
+  // blends (see groupBySkinning()); static meshes have one group with no
+  // skinning features covering all indices.
+  struct SkinGroup {
+    GLuint firstIndex; // relative to the mesh's firstIndex
+    GLsizei indexCount;
+    uint32_t features; // SKINNED plus RIGID / INFLUENCES_1 / INFLUENCES_2
+    int bone;          // the one bone a RIGID group follows
+  };
+  vector<SkinGroup> skinGroups;
+
+  // triangles on a single bone only get a RIGID group of their own when the
+  // bone has this many; fewer are not worth the extra draw
+  static const size_t RIGID_MIN_TRIANGLES = 64;
 
   // constructor
   Mesh(vector<Vertex> vertices, vector<unsigned int> indices,
        vector<Texture> textures, string name, string nodeName, aiAABB mAiAABB,
-       bool hasBones)
+       bool hasBones, bool upload = true)
       : nodeName(nodeName), hasBones(hasBones) {
     this->vertices = vertices;
     this->indices = indices;
@@ -82,6 +109,13 @@ public:
     this->mAABB = {
         .mMin = glm::vec3(mAiAABB.mMin.x, mAiAABB.mMin.y, mAiAABB.mMin.z),
         .mMax = glm::vec3(mAiAABB.mMax.x, mAiAABB.mMax.y, mAiAABB.mMax.z)};
+    if (hasBones) {
+      normalizeWeights();
+      collectInfluencingBones();
+      groupBySkinning();
+    } else {
+      skinGroups.push_back({0, indexCount(), 0, 0});
+    }
     // for (uint i = 0; i < this->vertices.size(); i++) {
     //   for (auto vertex : vertices) {
     //     std::cout << "x: " << vertex.Position.x << " y: " <<
@@ -93,76 +127,95 @@ public:
     // }
 
     // now that we have all the required data, set the vertex buffers and its
-    // attribute pointers.
-    setupMesh();
+    // attribute pointers. Offline tools build meshes without a GL context.
+    if (upload)
+      setupMesh();
   }
 
-  // render the mesh
-  void Draw(Shader &shader) {
-    std::unordered_map<std::string, unsigned int> textureCount;
-
-    for (unsigned int i = 0; i < textures.size(); i++) {
-      glActiveTexture(GL_TEXTURE0 + i); // activate texture unit
+  // texture -> unit table, one per program the mesh is drawn with. Units are
+  // fixed per program (Shader assigns them at link), so each table is built
+  // once; the variants of a ShaderVariants family each get their own. A
+  // table never moves once built, so packets may point into it.
+  struct MaterialBinding {
+    GLuint unit;
+    GLuint texture;
+    GLenum target;
+  };
 
-      std::string name =
-          textures[i].type; // e.g. "texture_diffuse", "texture_specular", etc.
-      std::string uniformName;
+  // `sortKey` is the texture that identifies the material for sorting:
+  // meshes sharing a texture array sort together even though their layers
+  // differ
+  struct MaterialTable {
+    vector<MaterialBinding> bindings;
+    GLuint sortKey = 0;
+  };
 
-      // Ensure each texture type has an incremented number suffix
-      unsigned int count = ++textureCount[name];
-      uniformName = name + std::to_string(count);
-      // std::cout << "  " << uniformName << " id: " << textures[i].id
-      //           << std::endl;
+  // layer of the diffuse map inside diffuseArray, -1 when the mesh samples a
+  // plain 2D texture (see Model::packTextureArrays)
+  GLuint diffuseArray = 0;
+  int diffuseLayer = -1;
 
-      // Send texture unit to shader
-      glUniform1i(glGetUniformLocation(shader.ID, uniformName.c_str()), i);
-
-      // Bind actual texture
-      glBindTexture(GL_TEXTURE_2D, textures[i].id);
-    }
+  void setDiffuseArray(GLuint array, int layer) {
+    diffuseArray = array;
+    diffuseLayer = layer;
+    materials.clear(); // recompile the binding tables on next use
+  }
 
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()),
-                   GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+  const MaterialTable &materialFor(const Shader &shader) {
+    auto it = materials.find(shader.ID);
+    if (it == materials.end())
+      it = materials.emplace(shader.ID, compileMaterial(shader)).first;
+    return it->second;
+  }
 
-    for (unsigned int i = 0; i < textures.size(); i++) {
-      glActiveTexture(GL_TEXTURE0 + i);
-      glBindTexture(GL_TEXTURE_2D, 0); // unbind texture
-    }
+  // the diffuse alpha is a cutout mask (glTF alphaMode MASK), set by the
+  // model loader
+  bool alphaTested = false;
 
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0); //
+  // ShaderFeature bits a model shader needs for this mesh's material; the
+  // skinning bits differ per SkinGroup
+  uint32_t shaderFeatures() const {
+    uint32_t features = 0;
+    if (diffuseLayer >= 0)
+      features |= ShaderFeature::TEXTURE_ARRAY;
+    if (alphaTested)
+      features |= ShaderFeature::ALPHA_TEST;
+    return features;
   }
 
-private:
-  // render data
-  unsigned int VBO, EBO;
-
-  // initializes all the buffer objects/arrays
-  void setupMesh() {
-    // create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+  GLsizei indexCount() const { return (GLsizei)indices.size(); }
 
-    glBindVertexArray(VAO);
-    // load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for
-    // all its items. The effect is that we can simply pass a pointer to the
-    // struct and it translates perfectly to a glm::vec3/2 array which again
-    // translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 &vertices[0], GL_STATIC_DRAW);
+  // where the mesh's indices and vertices start inside VAO's buffers; both 0
+  // unless the mesh was moved into a MeshPool
+  GLuint firstIndex = 0;
+  GLint baseVertex = 0;
+  const void *indexOffset() const {
+    return (const void *)(size_t)(firstIndex * sizeof(unsigned int));
+  }
+  const void *indexOffset(const SkinGroup &group) const {
+    return (const void *)(size_t)((firstIndex + group.firstIndex) *
+                                  sizeof(unsigned int));
+  }
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 &indices[0], GL_STATIC_DRAW);
+  // Switches the mesh to geometry that now lives in a shared MeshPool and
+  // frees its own buffers. The CPU copies stay for culling and tools.
+  void moveToPool(GLuint poolVAO, GLuint poolFirstIndex,
+                  GLint poolBaseVertex) {
+    if (VAO != 0) {
+      GLState::bindVertexArray(0);
+      glDeleteVertexArrays(1, &VAO);
+      GLState::deleteBuffer(VBO);
+      GLState::deleteBuffer(EBO);
+      VBO = EBO = 0;
+    }
+    VAO = poolVAO;
+    firstIndex = poolFirstIndex;
+    baseVertex = poolBaseVertex;
+  }
 
-    // set the vertex attribute pointers
+  // attribute layout of Vertex for the VAO and GL_ARRAY_BUFFER currently
+  // bound
+  static void setVertexAttributes() {
     // vertex Positions
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
@@ -191,7 +244,189 @@ private:
     glEnableVertexAttribArray(6);
     glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                           (void *)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
+  }
+
+private:
+  // render data
+  unsigned int VBO = 0, EBO = 0;
+
+  // by program ID
+  std::unordered_map<GLuint, MaterialTable> materials;
+
+  MaterialTable compileMaterial(const Shader &shader) const {
+    // samplers this mesh has no texture for read from texture 0, as they did
+    // when every draw unbound its units afterwards
+    MaterialTable table;
+    vector<MaterialBinding> &material = table.bindings;
+    material.assign(shader.samplerUnits(),
+                    MaterialBinding{0, 0, GL_TEXTURE_2D});
+    for (int unit = 0; unit < shader.samplerUnits(); unit++)
+      material[unit].unit = unit;
+    std::unordered_map<std::string, unsigned int> textureCount;
+    for (const Texture &texture : textures) {
+      // e.g. the second "texture_diffuse" binds to texture_diffuse2
+      unsigned int count = ++textureCount[texture.type];
+      int unit = shader.samplerUnit(texture.type + std::to_string(count));
+      if (unit >= 0) {
+        material[unit].texture = texture.id;
+        if (table.sortKey == 0)
+          table.sortKey = texture.id;
+      }
+    }
+    int arrayUnit = shader.samplerUnit("texture_diffuse_array");
+    if (diffuseArray != 0 && arrayUnit >= 0) {
+      material[arrayUnit].texture = diffuseArray;
+      material[arrayUnit].target = GL_TEXTURE_2D_ARRAY;
+      table.sortKey = diffuseArray;
+    }
+    return table;
+  }
+
+  // Drops the influences the shader could not use (no weight, no bone, or
+  // a bone past the palette), moves the rest to the front and scales them
+  // to sum to 1. The skinning variants then blend their first N slots
+  // without any checks; an unused slot is bone 0 with weight 0.
+  void normalizeWeights() {
+    for (Vertex &vertex : vertices) {
+      int ids[MAX_BONE_INFLUENCE];
+      float weights[MAX_BONE_INFLUENCE];
+      int count = 0;
+      float total = 0.0f;
+      for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        if (vertex.m_Weights[i] <= 0.0f || vertex.m_BoneIDs[i] < 0 ||
+            vertex.m_BoneIDs[i] >= UniformRing::MAX_BONES)
+          continue;
+        ids[count] = vertex.m_BoneIDs[i];
+        weights[count] = vertex.m_Weights[i];
+        total += weights[count];
+        count++;
+      }
+      for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        vertex.m_BoneIDs[i] = i < count ? ids[i] : 0;
+        vertex.m_Weights[i] = i < count ? weights[i] / total : 0.0f;
+      }
+    }
+  }
+
+  static int influenceCount(const Vertex &vertex) {
+    int count = 0;
+    while (count < MAX_BONE_INFLUENCE && vertex.m_Weights[count] > 0.0f)
+      count++;
+    return count;
+  }
+
+  // Reorders the triangles so that those needing the same skinning variant
+  // are contiguous, and records each run as a SkinGroup. A triangle needs
+  // as many influences as its most weighted vertex: none draws unskinned,
+  // 1 and 2 get INFLUENCES_1 / INFLUENCES_2, 3 and 4 the full SKINNED.
+  // Triangles whose vertices all follow the same single bone go RIGID,
+  // grouped per bone, when the bone has RIGID_MIN_TRIANGLES of them.
+  void groupBySkinning() {
+    struct Triangle {
+      uint32_t features;
+      int bone;
+      unsigned int first; // into indices
+    };
+    vector<Triangle> triangles;
+    std::unordered_map<int, size_t> rigidCount;
+    for (unsigned int t = 0; t + 2 < indices.size(); t += 3) {
+      int influences = 0;
+      int bone = -1;
+      bool rigid = true;
+      for (int k = 0; k < 3; k++) {
+        const Vertex &vertex = vertices[indices[t + k]];
+        int count = influenceCount(vertex);
+        influences = std::max(influences, count);
+        if (count != 1 || (bone >= 0 && bone != vertex.m_BoneIDs[0]))
+          rigid = false;
+        bone = vertex.m_BoneIDs[0];
+      }
+      uint32_t features = ShaderFeature::SKINNED;
+      if (influences == 0)
+        features = 0;
+      else if (rigid)
+        features |= ShaderFeature::RIGID;
+      else if (influences == 1)
+        features |= ShaderFeature::INFLUENCES_1;
+      else if (influences == 2)
+        features |= ShaderFeature::INFLUENCES_2;
+      if (features & ShaderFeature::RIGID)
+        rigidCount[bone]++;
+      triangles.push_back({features, rigid ? bone : 0, t});
+    }
+    // rigid triangles of sparsely used bones blend their one bone instead
+    for (Triangle &triangle : triangles)
+      if ((triangle.features & ShaderFeature::RIGID) &&
+          rigidCount[triangle.bone] < RIGID_MIN_TRIANGLES) {
+        triangle.features = ShaderFeature::SKINNED |
+                            ShaderFeature::INFLUENCES_1;
+        triangle.bone = 0;
+      }
+    std::stable_sort(triangles.begin(), triangles.end(),
+                     [](const Triangle &a, const Triangle &b) {
+                       return a.features != b.features
+                                  ? a.features < b.features
+                                  : a.bone < b.bone;
+                     });
+
+    vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for (const Triangle &triangle : triangles) {
+      SkinGroup *group = skinGroups.empty() ? nullptr : &skinGroups.back();
+      if (!group || group->features != triangle.features ||
+          group->bone != triangle.bone)
+        skinGroups.push_back(
+            {(GLuint)sorted.size(), 0, triangle.features, triangle.bone});
+      skinGroups.back().indexCount += 3;
+      sorted.insert(sorted.end(), indices.begin() + triangle.first,
+                    indices.begin() + triangle.first + 3);
+    }
+    indices = std::move(sorted);
+  }
+
+  // after normalizeWeights(), every used slot moves the vertex
+  void collectInfluencingBones() {
+    for (const Vertex &vertex : vertices) {
+      bool weighted = false;
+      for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        if (vertex.m_Weights[i] == 0.0f)
+          continue;
+        influencingBones.push_back(vertex.m_BoneIDs[i]);
+        weighted = true;
+      }
+      if (!weighted)
+        hasUnweightedVertices = true;
+    }
+    std::sort(influencingBones.begin(), influencingBones.end());
+    influencingBones.erase(
+        std::unique(influencingBones.begin(), influencingBones.end()),
+        influencingBones.end());
+  }
+
+  // initializes all the buffer objects/arrays
+  void setupMesh() {
+    // create buffers/arrays
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    GLState::bindVertexArray(VAO);
+    // load data into vertex buffers
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+    // A great thing about structs is that their memory layout is sequential for
+    // all its items. The effect is that we can simply pass a pointer to the
+    // struct and it translates perfectly to a glm::vec3/2 array which again
+    // translates to 3/2 floats which translates to a byte array.
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+                 &vertices[0], GL_STATIC_DRAW);
+
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                 &indices[0], GL_STATIC_DRAW);
+
+    // set the vertex attribute pointers
+    setVertexAttributes();
+    GLState::bindVertexArray(0);
   }
 };
 #endif
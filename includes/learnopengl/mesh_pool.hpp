@@ -0,0 +1,98 @@
+#pragma once
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/mesh.h"
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// One vertex and index buffer shared by many meshes, so that draws of
+// different meshes need no VAO change and can be merged into one
+// glMultiDrawElementsIndirect (see RenderQueue::enableIndirect). Each mesh
+// added keeps its range as Mesh::firstIndex / Mesh::baseVertex.
+//
+// The VAO also carries a per-draw index attribute (DRAW_ID_LOCATION, divisor
+// 1) reading 0, 1, 2, ... so an indirect command's baseInstance reaches the
+// shader as the index of its per-draw data; gl_BaseInstance would need
+// GL 4.6.
+//
+// Meant for static geometry loaded up front: every add() uploads the whole
+// pool again.
+class MeshPool {
+public:
+  static const GLuint DRAW_ID_LOCATION = 7;
+
+  struct Stats {
+    int meshes = 0;
+    size_t vertices = 0;
+    size_t indices = 0;
+  };
+
+  Stats stats;
+
+  GLuint vao() const { return vertexArray; }
+
+  void add(Mesh &mesh) {
+    if (vertexArray == 0)
+      create();
+    GLuint firstIndex = (GLuint)indices.size();
+    GLint baseVertex = (GLint)vertices.size();
+    vertices.insert(vertices.end(), mesh.vertices.begin(),
+                    mesh.vertices.end());
+    indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+    GLState::bindVertexArray(vertexArray);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+                 vertices.data(), GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                 indices.data(), GL_STATIC_DRAW);
+    GLState::bindVertexArray(0);
+
+    mesh.moveToPool(vertexArray, firstIndex, baseVertex);
+    stats.meshes++;
+    stats.vertices = vertices.size();
+    stats.indices = indices.size();
+  }
+
+  // makes sure draw ids 0 .. count-1 exist
+  void reserveDrawIds(size_t count) {
+    if (count <= drawIds)
+      return;
+    drawIds = std::max(count, drawIds * 2);
+    std::vector<uint32_t> ids(drawIds);
+    for (size_t i = 0; i < ids.size(); i++)
+      ids[i] = (uint32_t)i;
+    GLState::bindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(uint32_t), ids.data(),
+                 GL_STATIC_DRAW);
+  }
+
+private:
+  GLuint vertexArray = 0, vbo = 0, ebo = 0, drawIdBuffer = 0;
+  size_t drawIds = 0;
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+
+  void create() {
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glGenBuffers(1, &drawIdBuffer);
+
+    GLState::bindVertexArray(vertexArray);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    Mesh::setVertexAttributes();
+
+    GLState::bindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glEnableVertexAttribArray(DRAW_ID_LOCATION);
+    glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT,
+                           sizeof(uint32_t), (void *)0);
+    glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+    GLState::bindVertexArray(0);
+    reserveDrawIds(1024);
+  }
+};
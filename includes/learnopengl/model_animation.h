@@ -20,8 +20,12 @@
 
 #include "stb_image.h"
 
+#include <learnopengl/baked_asset.hpp>
 #include <learnopengl/mesh.h>
+#include <learnopengl/render_queue.hpp>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_array.hpp>
+#include <learnopengl/texture_streamer.hpp>
 
 #include <fstream>
 #include <glm/gtx/string_cast.hpp> // For glm::to_string
@@ -81,9 +85,10 @@ public:
 
   string directory;
   bool gammaCorrection;
+  // headless models keep CPU-side data only (used by hk_bake)
+  bool headless = false;
   string weaponNode = "";
   glm::vec3 weaponSize = glm::vec3(0.0f);
-  glm::vec3 weaponPos = glm::vec3(0.0f);
   std::unique_ptr<DebugBox> weaponHitbox;
   std::string currentAnim;
 
@@ -95,8 +100,10 @@ public:
   }
 
   Model(const aiScene *scene, const std::string &directory, glm::vec3 scale,
-        std::string name, std::string weaponMesh, bool gamma = false)
-      : name(name), directory(directory), gammaCorrection(gamma) {
+        std::string name, std::string weaponMesh, bool gamma = false,
+        bool headless = false)
+      : name(name), directory(directory), gammaCorrection(gamma),
+        headless(headless) {
     if (!scene || !scene->mRootNode) {
       std::cerr << "ERROR::MODEL::INVALID_SCENE_POINTER\n";
       return;
@@ -156,36 +163,56 @@ public:
     return glm::mat4(1.0f); // Identity if not found
   }
 
-  // draws the model, and thus all its meshes
-  void Draw(glm::mat4 objectModel, glm::mat4 projection, glm::mat4 view,
-            IAnimator &animator, Shader &shader, Shader &hitboxShader,
-            bool showHitbox) {
-    // bool hasBones = false;
-    for (unsigned int i = 0; i < meshes.size(); i++) {
-      Mesh mesh = meshes[i];
-
-      glm::mat4 localTransform = glm::mat4(1.0f);
-      // auto animatedNodeTransform =
-      // animator.GetGlobalNodeTransform(mesh.name);
-
-      std::optional<glm::mat4> animTrans;
-      if (!mesh.hasBones) {
-        animTrans = animator.getMeshTransform(i, animator.getFrame());
-        if (!animTrans.has_value()) {
-          localTransform = meshNodeTransforms[mesh.nodeName];
-        } else {
-          localTransform = animTrans.value();
-        }
-      }
-      glm::mat4 finalTransform = objectModel * localTransform;
+  // model-space transform of mesh i: skinned meshes are placed by their bones
+  // (identity here), the others follow their node animation channel or fall
+  // back to the static node transform
+  glm::mat4 MeshTransform(unsigned int i, IAnimator &animator) {
+    Mesh &mesh = meshes[i];
+    if (mesh.hasBones)
+      return glm::mat4(1.0f);
+    std::optional<glm::mat4> animTrans =
+        animator.getMeshTransform(i, animator.getFrame());
+    if (!animTrans.has_value())
+      return meshNodeTransforms[mesh.nodeName];
+    return animTrans.value();
+  }
 
-      // if (animTrans.has_value()) {
-      //   finalTransform *= *animTrans;
-      // }
+  // queues every mesh of the model (see Culling::submit for the culled path)
+  void Submit(RenderQueue &queue, const glm::mat4 &objectModel,
+              IAnimator &animator, ShaderVariants &shaders, uint32_t object) {
+    for (unsigned int i = 0; i < meshes.size(); i++)
+      queue.submit(shaders, meshes[i], objectModel * MeshTransform(i, animator),
+                   object);
+  }
 
-      shader.setMat4("model", finalTransform);
+  // Moves every mesh's diffuse map into texture arrays grouped by format and
+  // size, so consecutive meshes share one binding and only differ in layer.
+  // Needs GL 4.3; otherwise the meshes keep their 2D textures. Streamed
+  // textures stay 2D, their mips come and go one texture at a time.
+  void packTextureArrays() {
+    std::vector<GLuint> diffuse;
+    for (const Mesh &mesh : meshes)
+      for (const Texture &texture : mesh.textures)
+        if (texture.type == "texture_diffuse") {
+          if (!TextureStreamer::instance().streamed(texture.id))
+            diffuse.push_back(texture.id);
+          break;
+        }
 
-      mesh.Draw(shader);
+    auto layers = TextureArrays::pack(diffuse);
+    if (layers.empty())
+      return;
+    for (Mesh &mesh : meshes) {
+      for (Texture &texture : mesh.textures) {
+        if (texture.type != "texture_diffuse")
+          continue;
+        auto it = layers.find(texture.id);
+        if (it != layers.end() && it->second.array != 0) {
+          mesh.setDiffuseArray(it->second.array, it->second.layer);
+          texture.id = 0; // deleted by pack(), the array replaces it
+        }
+        break;
+      }
     }
   }
 
@@ -349,8 +376,16 @@ private:
 
     ExtractBoneWeightForVertices(vertices, mesh, scene);
 
-    return Mesh(vertices, indices, textures, mesh->mName.C_Str(),
-                node->mName.C_Str(), mesh->mAABB, mesh->HasBones());
+    Mesh result(vertices, indices, textures, mesh->mName.C_Str(),
+                node->mName.C_Str(), mesh->mAABB, mesh->HasBones(), !headless);
+    // cutout materials discard by the diffuse alpha (ALPHA_TEST); the key
+    // is assimp's AI_MATKEY_GLTF_ALPHAMODE, spelled out as older assimp
+    // versions keep it in a separate header
+    aiString alphaMode;
+    if (aiMaterial->Get("$mat.gltf.alphaMode", 0, 0, alphaMode) ==
+        AI_SUCCESS)
+      result.alphaTested = std::strcmp(alphaMode.C_Str(), "MASK") == 0;
+    return result;
   }
 
   void SetVertexBoneData(Vertex &vertex, int boneID, float weight) {
@@ -412,7 +447,14 @@ private:
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
+    // files on disk load unflipped, see the embedded ones below
+    std::string baked = BakedAssets::textureFile(filename);
+    unsigned int textureID =
+        TextureStreamer::instance().load(baked, false, filename);
+    if (textureID == 0)
+      textureID = BakedAssets::loadTexture(baked, false, filename);
+    if (textureID != 0)
+      return textureID;
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
@@ -427,7 +469,7 @@ private:
       else if (nrComponents == 4)
         format = GL_RGBA;
 
-      glBindTexture(GL_TEXTURE_2D, textureID);
+      GLState::bindTexture(GL_TEXTURE_2D, textureID);
       glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
                    GL_UNSIGNED_BYTE, data);
       glGenerateMipmap(GL_TEXTURE_2D);
@@ -456,20 +498,49 @@ private:
       aiString str;
       if (mat->GetTexture(type, i, &str) == AI_SUCCESS) {
         std::cout << "  Found texture: " << str.C_Str() << std::endl;
+        if (headless) {
+          // no GL context: remember the reference, hk_bake bakes the pixels
+          Texture texture;
+          texture.id = 0;
+          texture.type = typeName;
+          texture.path = str.C_Str();
+          textures.push_back(texture);
+          continue;
+        }
         if (str.C_Str()[0] == '*') {
           // embedded texture
           int texIndex = atoi(str.C_Str() + 1);
           aiTexture *tex = scene.mTextures[texIndex];
 
+          // compressed ones are flipped on load, raw texels are not; the
+          // baked file is named by content, so it cannot go stale
+          bool flipped = tex->mHeight == 0;
+          std::string bakedFile = BakedAssets::embeddedTextureFile(tex);
+          unsigned int bakedID =
+              TextureStreamer::instance().load(bakedFile, flipped);
+          if (bakedID == 0)
+            bakedID = BakedAssets::loadTexture(bakedFile, flipped);
+          if (bakedID != 0) {
+            Texture texture;
+            texture.id = bakedID;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);
+            continue;
+          }
+
           int width, height, nrComponents;
           unsigned char *data = nullptr;
 
           if (tex->mHeight == 0) {
-            // Compressed texture (PNG/JPG in memory)
+            // Compressed texture (PNG/JPG in memory); the flip is global
+            // stb state, so it is reset for the textures loaded after
             stbi_set_flip_vertically_on_load(true);
             data =
                 stbi_load_from_memory((unsigned char *)tex->pcData, tex->mWidth,
                                       &width, &height, &nrComponents, 0);
+            stbi_set_flip_vertically_on_load(false);
           } else {
             // Raw RGBA
             width = tex->mWidth;
@@ -491,7 +562,7 @@ private:
                           : (nrComponents == 3) ? GL_RGB
                                                 : GL_RGBA;
 
-          glBindTexture(GL_TEXTURE_2D, textureID);
+          GLState::bindTexture(GL_TEXTURE_2D, textureID);
           glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
                        GL_UNSIGNED_BYTE, data);
           glGenerateMipmap(GL_TEXTURE_2D);
@@ -9,16 +9,61 @@
 #include "learnopengl/assimp_glm_helpers.h"
 #include "learnopengl/bone.h"
 #include "learnopengl/box.hpp"
+#include "learnopengl/cpu_profiler.hpp"
+#include "learnopengl/culling.hpp"
+#include "learnopengl/immediate_renderer.hpp"
+#include "learnopengl/instanced_model.hpp"
 #include "learnopengl/model_animation.h"
 #include <algorithm>
 #include <assimp/Importer.hpp>
 #include <learnopengl/filesystem.h>
 #include <memory>
 #include <optional>
+#include <vector>
+
+// One actor as recorded for the render thread (see RenderThread): its world
+// matrix, mesh transforms and trimmed bone palette, copied so that the
+// simulation can move on. It answers Culling's and InstancedModel's
+// IAnimator questions from the recorded mesh transforms.
+struct RecordedActor : IAnimator {
+  Model *model = nullptr;
+  glm::mat4 world = glm::mat4(1.0f);
+  std::vector<glm::mat4> meshTransforms; // Model::MeshTransform per mesh
+  std::vector<glm::mat4> bones;
+  bool isHit = false;
+
+  std::optional<glm::mat4> GetGlobalNodeTransform(std::string) override {
+    return std::nullopt;
+  }
+  std::optional<glm::mat4> getMeshTransform(unsigned int meshIndex,
+                                            float) override {
+    return meshTransforms[meshIndex];
+  }
+  float getFrame() override { return 0.0f; }
+
+  // queues the meshes inside `frustum` (and, with `occlusion`, not hidden
+  // behind last frame's depth); the palette goes into the ring right away
+  void submit(RenderQueue &queue, ShaderVariants &shaders,
+              const Frustum &frustum, HiZ *occlusion = nullptr) {
+    RenderObject object;
+    object.bones = bones.data();
+    object.boneCount = (int)bones.size();
+    object.isHit = isHit;
+    Culling::submit(queue, *model, world, *this, bones, shaders, object,
+                    frustum, occlusion);
+  }
+
+  // instanced variant: adds the actor to `batch`, which must draw `model`
+  void submit(InstancedModel &batch, const Frustum &frustum,
+              HiZ *occlusion = nullptr) {
+    batch.add(world, *this, bones, isHit, frustum, occlusion);
+  }
+};
 
 class ModelAnimationAbs {
 public:
-  std::unique_ptr<Model> model;
+  // shared by every actor created from this one (see the sharing constructor)
+  std::shared_ptr<Model> model;
   glm::vec3 position{0.0f, 0.0f, 0.0f};
   glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
   glm::vec3 scale = glm::vec3(1.0f);
@@ -35,12 +80,16 @@ public:
   // glm::vec3 weaponSize = glm::vec3(0.0f);
   // std::unique_ptr<DebugBox> weaponHitbox;
 
+  glm::vec3 weaponPos = glm::vec3(0.0f);
+
   float lastHit = 0.0f;
   std::unique_ptr<DebugBox> hitbox;
   const bool showHitbox = true;
 
   Animator animator;
   const aiScene *scene;
+  // world matrix from the last update()
+  glm::mat4 modelMtx = glm::mat4(1.0f);
 
   ModelAnimationAbs(Assimp::Importer &importer, const std::string &path,
                     std::string name, std::string weaponMesh,
@@ -59,10 +108,12 @@ public:
         aiProcess_Triangulate | aiProcess_GenSmoothNormals |
             aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes);
     std::cout << "Loading model: " << path << std::endl;
-    this->model = std::make_unique<Model>(
+    this->model = std::make_shared<Model>(
         Model(scene, path.substr(0, path.find_last_of('/')), scale, name,
               weaponMesh, false));
     this->animator.m_GlobalNodeTransforms = this->model->meshNodeTransforms;
+    if (PACK_TEXTURE_ARRAYS)
+      this->model->packTextureArrays();
 
     aiVector3D rootMin(FLT_MAX, FLT_MAX, FLT_MAX);
     aiVector3D rootMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
@@ -99,11 +150,24 @@ public:
       aiAnimation *anim = scene->mAnimations[i];
       const char *name = anim->mName.C_Str();
       std::cout << "Found action " << name << std::endl;
-      this->nameToAnimation.insert(
+      this->animations->insert(
           {string(name), Animation(*scene, anim, name, model.get())});
     }
   }
 
+  // Another actor of the same asset: shares the model, the scene and the
+  // animation clips of `source` and only owns its own pose and state, so N
+  // actors cost one copy of the GPU data. Hitboxes stay with `source`.
+  ModelAnimationAbs(const ModelAnimationAbs &source, glm::vec3 position,
+                    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f))
+      : model(source.model), position(position), rotation(rotation),
+        scale(source.scale), modelSize(source.modelSize),
+        health(source.maxHealth), maxHealth(source.maxHealth),
+        weaponNodeName(source.weaponNodeName), animator(NULL),
+        scene(source.scene), animations(source.animations) {
+    this->animator.m_GlobalNodeTransforms = this->model->meshNodeTransforms;
+  }
+
   std::map<std::string, aiNodeAnim *> BuildMeshToChannel(aiAnimation *anim) {
     std::map<std::string, aiNodeAnim *> meshToChannel;
 
@@ -166,8 +230,8 @@ public:
 
   void setAnimation(std::string name, AnimationRunType type,
                     bool clearAfterDone) {
-    auto animationItr = this->nameToAnimation.find(name);
-    if (animationItr != this->nameToAnimation.end()) {
+    auto animationItr = this->animations->find(name);
+    if (animationItr != this->animations->end()) {
       std::cout << "playing animation " << name << std::endl;
       this->animator.PlayAnimation(&animationItr->second, type,
                                    this->model->meshNodeTransforms,
@@ -178,6 +242,7 @@ public:
   }
 
   void updatePosition(float deltaTime) {
+    PROFILE_ZONE("ModelAnimationAbs::updatePosition");
     if (glm::length(this->velocity) > 0.01) {
       this->position += this->velocity * deltaTime;
       this->position.y = std::max(this->position.y, 0.0f);
@@ -189,91 +254,64 @@ public:
     // }
   }
 
-  void draw(glm::mat4 parentMtx, glm::mat4 projection, glm::mat4 view,
-            Shader &shader, Shader &hitboxShader, float deltaTime,
-            float lastFrame) {
+  // advances the animation and everything derived from it (world matrix,
+  // weapon position); must run before record() each frame
+  void update(glm::mat4 parentMtx, float deltaTime) {
     if (health <= 0) {
       return;
     }
-    shader.use();
-    shader.setMat4("projection", projection);
-    shader.setMat4("view", view);
-
-    GLint isHitLocation = glGetUniformLocation(shader.ID, "isHit");
-
-    if (lastFrame < DAMAGE_EFFECT + lastHit) {
-      // std::cout << "lastFrame: " << lastFrame << " lastHit: " << lastHit
-      //           << std::endl;
-      glUniform1i(isHitLocation, true);
-    } else {
-      glUniform1i(isHitLocation, false);
-    }
-
-    glm::mat4 modelMtx = glm::translate(parentMtx, position);
+    modelMtx = glm::translate(parentMtx, position);
     modelMtx *= glm::toMat4(rotation);
     modelMtx = glm::scale(modelMtx, glm::vec3(scale));
 
     animator.updateAnim(deltaTime);
-    std::vector<glm::mat4> finalTransforms = animator.GetFinalBoneMatrices();
-    for (size_t i = 0; i < finalTransforms.size(); ++i) {
-      glUniformMatrix4fv(
-          glGetUniformLocation(
-              shader.ID,
-              ("finalBonesMatrices[" + std::to_string(i) + "]").c_str()),
-          1, GL_FALSE, glm::value_ptr(finalTransforms[i]));
+
+    if (showHitbox && this->model->weaponHitbox != nullptr &&
+        this->weaponNodeName != "") {
+      auto boneTransform =
+          animator.GetGlobalNodeTransform(this->weaponNodeName);
+      glm::mat4 localTransform = boneTransform.value();
+      glm::mat4 weaponGlobal = modelMtx * localTransform;
+      this->weaponPos = glm::vec3(weaponGlobal[3]);
     }
+  }
 
-    // if (weaponMesh == "hornet.008") {
-    //   std::cout << "anim" << animator.GetAnimation() << std::endl;
-    // }
-    model->Draw(modelMtx, projection, view, animator, shader, hitboxShader,
-                showHitbox);
-    if (showHitbox) {
-      hitboxShader.use();
-      hitboxShader.setMat4("projection", projection);
-      hitboxShader.setMat4("view", view);
+  // copies what drawing this frame needs into `actor`; false when there is
+  // nothing to draw
+  bool record(RecordedActor &actor, float lastFrame) {
+    if (health <= 0) {
+      return false;
+    }
+    actor.model = model.get();
+    actor.world = modelMtx;
+    actor.meshTransforms.resize(model->meshes.size());
+    for (unsigned int i = 0; i < model->meshes.size(); i++)
+      actor.meshTransforms[i] = model->MeshTransform(i, animator);
+    // only the bones the model actually has; the animator keeps 100
+    const std::vector<glm::mat4> &bones = animator.GetFinalBoneMatrices();
+    size_t used =
+        std::min(bones.size(), (size_t)std::max(1, model->GetBoneCount()));
+    actor.bones.assign(bones.begin(), bones.begin() + used);
+    actor.isHit = lastFrame < DAMAGE_EFFECT + lastHit;
+    return true;
+  }
 
+  // adds the body and weapon hitboxes to `batch` (shared actors have none)
+  void drawHitboxes(ImmediateRenderer &batch) const {
+    if (health <= 0) {
+      return;
+    }
+    if (hitbox) {
       glm::vec3 pos = glm::vec3(modelMtx[3]);
       pos.y += modelSize.y / 2.0;
-      // hitbox->setVisible(true);
-      // hitbox->draw(glm::translate(glm::mat4(1.0f), pos), hitboxShader);
-
-      if (showHitbox && this->model->weaponHitbox != nullptr &&
-          this->weaponNodeName != "") {
-        // hitboxShader.use();
-        // hitboxShader.setMat4("projection", projection);
-        // hitboxShader.setMat4("view", view);
-
-        auto boneTransform =
-            animator.GetGlobalNodeTransform(this->weaponNodeName);
-        glm::mat4 localTransform = boneTransform.value();
-        // if (boneTransform.has_value()) {
-        //   localTransform = boneTransform.value();
-        // } else {
-        //   localTransform = this->model->meshNodeTransforms[i];
-        // }
-        glm::mat4 weaponGlobal = modelMtx * localTransform;
-        this->model->weaponPos = glm::vec3(weaponGlobal[3]);
-        // if (this->name == "hornet") {
-        //   // std::cout << animator.GetGlobalNodeTransforms().size() <<
-        //   // std::endl; for (auto pair : animator.GetGlobalNodeTransforms())
-        //   {
-        //   //   std::cout << pair << " " << std::endl;
-        //   // }
-        //   // std::cout << glm::to_string(localTransform)
-        //   //           << (boneTransform.has_value() ? "has bones" : "")
-        //   //           << std::endl;
-        // }
-        
-        // this->model->weaponHitbox->setVisible(true);
-        // this->model->weaponHitbox->draw(
-        //     glm::translate(glm::mat4(1.0f), this->model->weaponPos),
-        //     hitboxShader);
-      }
+      hitbox->draw(glm::translate(glm::mat4(1.0f), pos), batch);
     }
+    if (this->model->weaponHitbox != nullptr && this->weaponNodeName != "")
+      this->model->weaponHitbox->draw(
+          glm::translate(glm::mat4(1.0f), weaponPos), batch);
   }
 
-  glm::vec3 getWeaponPosition() { return model->weaponPos; }
+  glm::vec3 getWeaponPosition() { return weaponPos; }
 
   glm::vec3 getFront() {
     // The local forward vector (model-space)
@@ -287,5 +325,6 @@ public:
   }
 
 private:
-  std::map<string, Animation> nameToAnimation{};
+  std::shared_ptr<std::map<string, Animation>> animations =
+      std::make_shared<std::map<string, Animation>>();
 };
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries. Entries are keyed by a hash of the
+// shader sources plus the GL vendor/renderer/version strings, so a driver
+// update or an edited shader simply misses and falls back to a full compile.
+namespace ProgramCache {
+
+const uint32_t MAGIC = 0x42504b48; // "HKPB"
+const uint32_t FORMAT_VERSION = 1;
+
+inline std::string &directory() {
+  static std::string dir = "cache/shaders";
+  return dir;
+}
+
+// FNV-1a, good enough to key a handful of shader sources
+inline uint64_t hash(const std::string &data,
+                     uint64_t seed = 14695981039346656037ull) {
+  uint64_t h = seed;
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+inline bool supported() {
+  static int cached = -1;
+  if (cached == -1) {
+    GLint formats = 0;
+    if (GLAD_GL_VERSION_4_1)
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    cached = formats > 0 ? 1 : 0;
+  }
+  return cached == 1;
+}
+
+inline const std::string &driverKey() {
+  static std::string key;
+  if (key.empty()) {
+    auto str = [](GLenum name) {
+      const GLubyte *s = glGetString(name);
+      return s ? std::string(reinterpret_cast<const char *>(s)) : "";
+    };
+    key = str(GL_VENDOR) + "|" + str(GL_RENDERER) + "|" + str(GL_VERSION);
+  }
+  return key;
+}
+
+inline std::filesystem::path entryPath(const std::string &sources) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin",
+                (unsigned long long)hash(driverKey(), hash(sources)));
+  return std::filesystem::path(directory()) / name;
+}
+
+// Must be called before glLinkProgram for the driver to keep the binary around.
+inline void prepare(GLuint program) {
+  if (supported())
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// Tries to restore `program` from the cache. Returns false on any mismatch, in
+// which case the program is left unusable and the caller should rebuild it.
+inline bool load(GLuint program, const std::string &sources) {
+  if (!supported())
+    return false;
+
+  std::ifstream file(entryPath(sources), std::ios::binary);
+  if (!file)
+    return false;
+
+  uint32_t magic = 0, version = 0, keyLength = 0, length = 0;
+  uint64_t sourceHash = 0;
+  GLenum format = 0;
+  file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char *>(&version), sizeof(version));
+  file.read(reinterpret_cast<char *>(&sourceHash), sizeof(sourceHash));
+  file.read(reinterpret_cast<char *>(&keyLength), sizeof(keyLength));
+  if (!file || magic != MAGIC || version != FORMAT_VERSION ||
+      sourceHash != hash(sources) || keyLength != driverKey().size())
+    return false;
+
+  std::string key(keyLength, '\0');
+  file.read(key.data(), keyLength);
+  file.read(reinterpret_cast<char *>(&format), sizeof(format));
+  file.read(reinterpret_cast<char *>(&length), sizeof(length));
+  if (!file || key != driverKey())
+    return false;
+
+  std::vector<char> binary(length);
+  file.read(binary.data(), length);
+  if (!file)
+    return false;
+
+  glProgramBinary(program, format, binary.data(), (GLsizei)length);
+  GLint success = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  return success == GL_TRUE;
+}
+
+inline void store(GLuint program, const std::string &sources) {
+  if (!supported())
+    return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+  std::error_code ec;
+  std::filesystem::create_directories(directory(), ec);
+  std::filesystem::path path = entryPath(sources);
+  std::filesystem::path tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE " << tmp << std::endl;
+      return;
+    }
+    uint64_t sourceHash = hash(sources);
+    uint32_t keyLength = (uint32_t)driverKey().size();
+    uint32_t binaryLength = (uint32_t)length;
+    file.write(reinterpret_cast<const char *>(&MAGIC), sizeof(MAGIC));
+    file.write(reinterpret_cast<const char *>(&FORMAT_VERSION),
+               sizeof(FORMAT_VERSION));
+    file.write(reinterpret_cast<const char *>(&sourceHash),
+               sizeof(sourceHash));
+    file.write(reinterpret_cast<const char *>(&keyLength), sizeof(keyLength));
+    file.write(driverKey().data(), keyLength);
+    file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    file.write(reinterpret_cast<const char *>(&binaryLength),
+               sizeof(binaryLength));
+    file.write(binary.data(), length);
+  }
+  // rename so a crash mid-write never leaves a truncated entry behind
+  std::filesystem::rename(tmp, path, ec);
+}
+
+} // namespace ProgramCache
@@ -0,0 +1,469 @@
+#pragma once
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/gpu_profiler.hpp"
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-frame render graph. Each frame the passes are declared again with the
+// textures they create, read and write; compile() orders them, drops passes
+// whose results nobody uses and maps transient textures onto a pool so
+// resources whose lifetimes do not overlap share one GL texture. execute()
+// binds an FBO built from each pass's attachments and times the pass on the
+// CPU and, when a GpuProfiler is attached, on the GPU.
+//
+// Ordering, per resource: the pass that creates or only writes it runs
+// first, then passes that read and write it (in declaration order), then the
+// passes that only read it. So an opaque pass that writes depth always runs
+// before a sky pass that tests against it, whatever order they were added.
+class RenderGraph {
+public:
+  using Resource = int;
+  static const Resource NONE = -1;
+
+  struct TextureDesc {
+    int width = 0;
+    int height = 0;
+    GLenum format = GL_RGBA8;
+
+    bool operator==(const TextureDesc &o) const {
+      return width == o.width && height == o.height && format == o.format;
+    }
+  };
+
+  struct PassStats {
+    std::string name;
+    double cpuMs = 0.0;
+    double gpuMs = 0.0; // from a few frames ago, the profiler result lags
+  };
+
+  struct Stats {
+    int passes = 0;
+    int culled = 0;       // declared but not needed this frame
+    int textures = 0;     // transient textures used this frame
+    int allocations = 0;  // pool textures backing them
+    int fbos = 0;
+  };
+
+  class Builder {
+  public:
+    // a transient texture this pass writes first
+    Resource create(const std::string &name, const TextureDesc &desc) {
+      Resource r = graph.addResource(name, desc, 0, false);
+      write(r);
+      return r;
+    }
+    void read(Resource r) { graph.passes[pass].reads.push_back(r); }
+    void write(Resource r) { graph.passes[pass].writes.push_back(r); }
+    // keep the pass even though no other pass reads what it writes
+    void sideEffect() { graph.passes[pass].sideEffect = true; }
+
+  private:
+    friend class RenderGraph;
+    Builder(RenderGraph &graph, int pass) : graph(graph), pass(pass) {}
+    RenderGraph &graph;
+    int pass;
+  };
+
+  // handed to execute callbacks
+  class Context {
+  public:
+    GLuint texture(Resource r) const { return graph.resources[r].texture; }
+    const TextureDesc &desc(Resource r) const {
+      return graph.resources[r].desc;
+    }
+
+    // copies colour resource `r` into the framebuffer the pass renders to,
+    // stretched (bilinear) to `width` x `height` when those are given
+    void blit(Resource r, int width = 0, int height = 0) const {
+      const TextureDesc &d = desc(r);
+      if (width <= 0 || height <= 0) {
+        width = d.width;
+        height = d.height;
+      }
+      bool scaled = width != d.width || height != d.height;
+      GLuint target = GLState::cache().framebuffer;
+      GLuint source = graph.framebufferFor({texture(r)}, 0, "blit");
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+      glBlitFramebuffer(0, 0, d.width, d.height, 0, 0, width, height,
+                        GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+      // the split binds leave GL_FRAMEBUFFER unknown to the cache
+      GLState::cache().framebuffer = GLState::UNKNOWN;
+      GLState::bindFramebuffer(target);
+    }
+
+  private:
+    friend class RenderGraph;
+    explicit Context(RenderGraph &graph) : graph(graph) {}
+    RenderGraph &graph;
+  };
+
+  using SetupFn = std::function<void(Builder &)>;
+  using ExecuteFn = std::function<void(const Context &)>;
+
+  // textures owned elsewhere; texture 0 stands for the default framebuffer
+  Resource import(const std::string &name, GLuint texture,
+                  const TextureDesc &desc) {
+    return addResource(name, desc, texture, true);
+  }
+
+  void addPass(const std::string &name, const SetupFn &setup,
+               const ExecuteFn &execute) {
+    passes.push_back(Pass());
+    passes.back().name = name;
+    passes.back().execute = execute;
+    Builder builder(*this, (int)passes.size() - 1);
+    setup(builder);
+  }
+
+  // times every pass as a scope of `profiler` (nullptr to stop)
+  void profile(GpuProfiler *profiler) { this->profiler = profiler; }
+
+  void compile() {
+    order.clear();
+    stats = Stats();
+    stats.passes = (int)passes.size();
+    if (!sortPasses()) {
+      std::cout << "ERROR::RENDER_GRAPH:: cycle between passes, running them "
+                   "in declaration order"
+                << std::endl;
+      order.clear();
+      for (int i = 0; i < (int)passes.size(); i++)
+        order.push_back(i);
+    }
+    cullPasses();
+    allocateTextures();
+  }
+
+  void execute() {
+    Context context(*this);
+    frameStats.clear();
+    for (int index : order) {
+      Pass &pass = passes[index];
+      PassStats passStats;
+      passStats.name = pass.name;
+
+      if (profiler)
+        profiler->begin(pass.name);
+      auto start = std::chrono::high_resolution_clock::now();
+
+      bindTarget(pass);
+      pass.execute(context);
+
+      auto end = std::chrono::high_resolution_clock::now();
+      if (profiler) {
+        profiler->end();
+        passStats.gpuMs = profiler->latest(pass.name);
+      }
+      passStats.cpuMs =
+          std::chrono::duration<double, std::milli>(end - start).count();
+      frameStats.push_back(passStats);
+    }
+    GLState::bindFramebuffer(0);
+
+    // next frame declares everything again; the pool and FBOs stay
+    passes.clear();
+    resources.clear();
+    order.clear();
+    trimPool();
+  }
+
+  // passes of the last executed frame, in execution order
+  const std::vector<PassStats> &passStats() const { return frameStats; }
+  const Stats &frame() const { return stats; }
+
+private:
+  struct ResourceNode {
+    std::string name;
+    TextureDesc desc;
+    GLuint texture = 0;
+    bool imported = false;
+    int firstUse = -1, lastUse = -1; // positions in `order`
+  };
+
+  struct Pass {
+    std::string name;
+    ExecuteFn execute;
+    std::vector<Resource> reads;
+    std::vector<Resource> writes;
+    bool sideEffect = false;
+    bool needed = false;
+  };
+
+  struct PooledTexture {
+    GLuint texture = 0;
+    TextureDesc desc;
+    bool inUse = false;
+    int idleFrames = 0;
+  };
+
+  std::vector<Pass> passes;
+  std::vector<ResourceNode> resources;
+  std::vector<int> order;
+  std::vector<PooledTexture> pool;
+  std::map<std::vector<GLuint>, GLuint> fbos; // attachments -> framebuffer
+  GpuProfiler *profiler = nullptr;
+  std::vector<PassStats> frameStats;
+  Stats stats;
+
+  // pool textures unused for this many frames are freed (e.g. after resize)
+  static const int MAX_IDLE_FRAMES = 60;
+
+  Resource addResource(const std::string &name, const TextureDesc &desc,
+                       GLuint texture, bool imported) {
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    node.texture = texture;
+    node.imported = imported;
+    resources.push_back(node);
+    return (Resource)resources.size() - 1;
+  }
+
+  static bool contains(const std::vector<Resource> &list, Resource r) {
+    return std::find(list.begin(), list.end(), r) != list.end();
+  }
+
+  static bool isDepthFormat(GLenum format) {
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 ||
+           format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 ||
+           format == GL_DEPTH32F_STENCIL8;
+  }
+
+  // Kahn's algorithm over the producer -> modifier -> consumer edges, taking
+  // the earliest declared ready pass first so unrelated passes keep their order
+  bool sortPasses() {
+    int count = (int)passes.size();
+    std::vector<std::vector<int>> edges(count);
+    std::vector<int> incoming(count, 0);
+    auto addEdge = [&](int from, int to) {
+      if (from == to)
+        return;
+      edges[from].push_back(to);
+      incoming[to]++;
+    };
+
+    for (Resource r = 0; r < (Resource)resources.size(); r++) {
+      std::vector<int> producers, modifiers, consumers;
+      for (int p = 0; p < count; p++) {
+        bool reads = contains(passes[p].reads, r);
+        bool writes = contains(passes[p].writes, r);
+        if (writes && !reads)
+          producers.push_back(p);
+        else if (writes)
+          modifiers.push_back(p);
+        else if (reads)
+          consumers.push_back(p);
+      }
+      for (int p : producers) {
+        for (int m : modifiers)
+          addEdge(p, m);
+        for (int c : consumers)
+          addEdge(p, c);
+      }
+      for (size_t i = 1; i < modifiers.size(); i++)
+        addEdge(modifiers[i - 1], modifiers[i]);
+      for (int m : modifiers)
+        for (int c : consumers)
+          addEdge(m, c);
+    }
+
+    std::vector<bool> done(count, false);
+    for (int step = 0; step < count; step++) {
+      int pick = -1;
+      for (int p = 0; p < count && pick < 0; p++)
+        if (!done[p] && incoming[p] == 0)
+          pick = p;
+      if (pick < 0)
+        return false;
+      done[pick] = true;
+      order.push_back(pick);
+      for (int to : edges[pick])
+        incoming[to]--;
+    }
+    return true;
+  }
+
+  // a pass is needed when it has a side effect, writes an imported resource
+  // or writes something a needed pass reads
+  void cullPasses() {
+    for (int i = (int)order.size() - 1; i >= 0; i--) {
+      Pass &pass = passes[order[i]];
+      pass.needed = pass.sideEffect;
+      for (Resource r : pass.writes)
+        if (resources[r].imported)
+          pass.needed = true;
+      for (int j = i + 1; j < (int)order.size() && !pass.needed; j++) {
+        const Pass &later = passes[order[j]];
+        if (!later.needed)
+          continue;
+        for (Resource r : pass.writes)
+          if (contains(later.reads, r))
+            pass.needed = true;
+      }
+    }
+    std::vector<int> kept;
+    for (int index : order)
+      if (passes[index].needed)
+        kept.push_back(index);
+    stats.culled = (int)(order.size() - kept.size());
+    order = kept;
+  }
+
+  // lifetimes in execution order, then greedy reuse of pool textures whose
+  // previous user has finished
+  void allocateTextures() {
+    for (int i = 0; i < (int)order.size(); i++) {
+      const Pass &pass = passes[order[i]];
+      for (const std::vector<Resource> *list : {&pass.reads, &pass.writes})
+        for (Resource r : *list) {
+          ResourceNode &node = resources[r];
+          if (node.firstUse < 0)
+            node.firstUse = i;
+          node.lastUse = i;
+        }
+    }
+
+    for (PooledTexture &pooled : pool) {
+      pooled.inUse = false;
+      pooled.idleFrames++;
+    }
+    std::vector<int> owner(resources.size(), -1);
+    std::vector<bool> used(pool.size(), false);
+    for (int i = 0; i < (int)order.size(); i++) {
+      for (Resource r = 0; r < (Resource)resources.size(); r++) {
+        ResourceNode &node = resources[r];
+        if (node.imported || node.firstUse != i)
+          continue;
+        int slot = -1;
+        for (int t = 0; t < (int)pool.size() && slot < 0; t++)
+          if (!pool[t].inUse && pool[t].desc == node.desc)
+            slot = t;
+        if (slot < 0) {
+          pool.push_back(createTexture(node.desc));
+          used.push_back(false);
+          slot = (int)pool.size() - 1;
+        }
+        pool[slot].inUse = true;
+        pool[slot].idleFrames = 0;
+        used[slot] = true;
+        node.texture = pool[slot].texture;
+        owner[r] = slot;
+        stats.textures++;
+      }
+      // release what this pass was the last user of
+      for (Resource r = 0; r < (Resource)resources.size(); r++)
+        if (owner[r] >= 0 && resources[r].lastUse == i)
+          pool[owner[r]].inUse = false;
+    }
+    stats.allocations = (int)std::count(used.begin(), used.end(), true);
+    stats.fbos = (int)fbos.size();
+  }
+
+  static PooledTexture createTexture(const TextureDesc &desc) {
+    PooledTexture pooled;
+    pooled.desc = desc;
+    bool depth = isDepthFormat(desc.format);
+    glGenTextures(1, &pooled.texture);
+    GLState::bindTexture(GL_TEXTURE_2D, pooled.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0,
+                 depth ? GL_DEPTH_COMPONENT : GL_RGBA,
+                 depth ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+    GLint filter = depth ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return pooled;
+  }
+
+  // framebuffer for the textures a pass writes; the default framebuffer when
+  // it writes the imported backbuffer (texture 0) or nothing at all. The
+  // viewport follows the target, since targets may be smaller than the screen.
+  void bindTarget(const Pass &pass) {
+    std::vector<GLuint> colors;
+    GLuint depth = 0;
+    int width = 0, height = 0;
+    bool backbuffer = false;
+    for (Resource r : pass.writes) {
+      const ResourceNode &node = resources[r];
+      width = node.desc.width;
+      height = node.desc.height;
+      if (node.texture == 0) {
+        backbuffer = true;
+        break;
+      }
+      if (isDepthFormat(node.desc.format))
+        depth = node.texture;
+      else
+        colors.push_back(node.texture);
+    }
+    if (backbuffer || (colors.empty() && depth == 0)) {
+      GLState::bindFramebuffer(0);
+      if (backbuffer)
+        glViewport(0, 0, width, height);
+      return;
+    }
+    GLState::bindFramebuffer(framebufferFor(colors, depth, pass.name));
+    glViewport(0, 0, width, height);
+  }
+
+  GLuint framebufferFor(const std::vector<GLuint> &colors, GLuint depth,
+                        const std::string &user) {
+    std::vector<GLuint> key = colors;
+    key.push_back(depth);
+    auto it = fbos.find(key);
+    if (it == fbos.end()) {
+      GLuint fbo = 0;
+      glGenFramebuffers(1, &fbo);
+      GLState::bindFramebuffer(fbo);
+      std::vector<GLenum> buffers;
+      for (size_t i = 0; i < colors.size(); i++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i,
+                               GL_TEXTURE_2D, colors[i], 0);
+        buffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+      }
+      if (depth)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                               GL_TEXTURE_2D, depth, 0);
+      if (buffers.empty())
+        glDrawBuffer(GL_NONE);
+      else
+        glDrawBuffers((GLsizei)buffers.size(), buffers.data());
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::RENDER_GRAPH:: framebuffer of " << user
+                  << " is not complete" << std::endl;
+      it = fbos.emplace(key, fbo).first;
+    }
+    return it->second;
+  }
+
+  // frees pool textures nobody used for a while, with every FBO that might
+  // reference them
+  void trimPool() {
+    bool freed = false;
+    for (size_t t = 0; t < pool.size();) {
+      if (pool[t].idleFrames > MAX_IDLE_FRAMES) {
+        glDeleteTextures(1, &pool[t].texture);
+        pool.erase(pool.begin() + t);
+        freed = true;
+      } else {
+        t++;
+      }
+    }
+    if (!freed)
+      return;
+    GLState::bindFramebuffer(0);
+    for (auto &[key, fbo] : fbos)
+      glDeleteFramebuffers(1, &fbo);
+    fbos.clear();
+    GLState::invalidate(); // deleted textures may still sit in the cache
+  }
+};
@@ -0,0 +1,313 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/cpu_profiler.hpp>
+#include <learnopengl/gl_state.hpp>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_pool.hpp>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.hpp>
+#include <learnopengl/texture_streamer.hpp>
+#include <learnopengl/uniform_ring.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Per-frame list of draws. Models submit small POD packets instead of drawing
+// immediately; flush() sorts them by a 64-bit state key and issues them in one
+// pass so program, texture and VAO changes only happen when the key changes.
+// Per-object and per-draw constants go through a UniformRing, so a draw binds
+// buffer ranges instead of uploading uniforms.
+//
+// Models submit through a ShaderVariants family and each packet gets the
+// variant its mesh and object need (skinning, texture array, hit flash), so
+// those become part of the program in the key rather than shader branches.
+// A skinned mesh becomes one packet per Mesh::SkinGroup, each with the
+// variant for its influence count.
+//
+// Static meshes kept in a MeshPool can skip the per-draw loop altogether, see
+// enableIndirect().
+//
+// Key layout, most significant first:
+//   63..60 layer    (opaque first)
+//   59..48 program
+//   47..32 material (texture array or first texture of the mesh)
+//   31..24 object   (which BONES range is bound)
+//   23..0  depth    (front to back)
+//
+// Objects sort below program and material, so the packets of one skinned
+// object interleave with other objects'. That costs a BONES rebind, not an
+// upload: addObject() pushes each palette into the ring once per frame and
+// flush() only binds the object's range again.
+struct DrawPacket {
+  uint64_t key;
+  Shader *shader;
+  GLuint vao;
+  GLsizei indexCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  const Mesh::MaterialBinding *material;
+  uint32_t materialCount;
+  int layer; // diffuse texture array layer, -1 for plain 2D textures
+  int bone;  // the bone of a RIGID group
+  bool indirect;      // merged into multi-draws, see enableIndirect()
+  uint32_t transform; // index into RenderQueue::transforms
+  uint32_t object;    // index into RenderQueue::objects
+  float depth;
+};
+
+// state shared by every packet of one submitted object
+struct RenderObject {
+  const glm::mat4 *bones = nullptr;
+  int boneCount = 0;
+  bool isHit = false;
+  // the bones pushed into the ring by addObject(), once per frame
+  UniformRing::Range palette;
+};
+
+class RenderQueue {
+public:
+  enum Layer : uint64_t { LAYER_OPAQUE = 0, LAYER_TRANSPARENT = 1 };
+
+  // shader storage binding of the per-draw ObjectBlocks on the indirect path
+  static const GLuint DRAW_DATA_BINDING = 2;
+
+  struct Stats {
+    int packets = 0;
+    int programChanges = 0;
+    int objectChanges = 0;
+    int palettes = 0; // bone palettes pushed, one per skinned object
+    int indirectDraws = 0;    // glMultiDrawElementsIndirect calls
+    int indirectCommands = 0; // packets they covered
+    int dropped = 0; // packets whose constants did not fit in the ring
+  };
+
+  std::vector<DrawPacket> packets;
+  std::vector<glm::mat4> transforms;
+  std::vector<RenderObject> objects;
+  Stats stats;
+
+  // vectors keep their capacity across frames, so after the first few frames
+  // submitting allocates nothing. `ring` takes the objects' bone palettes
+  // and must be the one flush() gets.
+  void begin(UniformRing &ring, const glm::mat4 &view, float farPlane) {
+    packets.clear();
+    transforms.clear();
+    objects.clear();
+    this->ring = &ring;
+    this->view = view;
+    this->farPlane = farPlane;
+  }
+
+  // Meshes of `pool` submitted through a ShaderVariants family are merged:
+  // they get the INDIRECT variant, and every run of them that shares layer,
+  // program and textures becomes one glMultiDrawElementsIndirect, with the
+  // commands and each draw's ObjectBlock pushed into the ring. The shader
+  // finds its block through the pool's draw id attribute, so pooled meshes
+  // must have no bones. Needs GL 4.3; returns false without it, and pooled
+  // meshes keep going through the per-draw path.
+  bool enableIndirect(MeshPool &pool) {
+    if (!GLAD_GL_VERSION_4_3)
+      return false;
+    this->pool = &pool;
+    return true;
+  }
+
+  // pushes the object's palette now, so all its packets share one copy
+  uint32_t addObject(const RenderObject &object) {
+    objects.push_back(object);
+    RenderObject &added = objects.back();
+    if (added.bones)
+      added.palette = ring->pushBones(added.bones, added.boneCount);
+    return (uint32_t)objects.size() - 1;
+  }
+
+  // `features` are added to the ones the mesh and object ask for
+  void submit(ShaderVariants &shaders, Mesh &mesh, const glm::mat4 &transform,
+              uint32_t object, uint32_t features = 0,
+              Layer layer = LAYER_OPAQUE) {
+    features |= mesh.shaderFeatures();
+    if (objects[object].isHit)
+      features |= ShaderFeature::HIT_FLASH;
+    bool indirect = pool && mesh.VAO == pool->vao() && !mesh.hasBones;
+    if (indirect)
+      features |= ShaderFeature::INDIRECT;
+    uint32_t transformIndex = addTransform(mesh, transform);
+    for (const Mesh::SkinGroup &group : mesh.skinGroups) {
+      push(shaders.get(features | group.features), mesh, group,
+           transformIndex, object, layer);
+      packets.back().indirect = indirect;
+    }
+  }
+
+  // draws all of `mesh` with `shader`, whatever its skin groups
+  void submit(Shader &shader, Mesh &mesh, const glm::mat4 &transform,
+              uint32_t object, Layer layer = LAYER_OPAQUE) {
+    push(shader, mesh, {0, mesh.indexCount(), 0, 0},
+         addTransform(mesh, transform), object, layer);
+  }
+
+  // the ring's Frame block must already be bound
+  void flush(UniformRing &ring) {
+    PROFILE_ZONE("RenderQueue::flush");
+    std::sort(packets.begin(), packets.end(),
+              [](const DrawPacket &a, const DrawPacket &b) {
+                return a.key < b.key;
+              });
+
+    stats = Stats();
+    stats.packets = (int)packets.size();
+    for (const RenderObject &o : objects)
+      stats.palettes += o.bones ? 1 : 0;
+    Shader *shader = nullptr;
+    uint32_t object = UINT32_MAX;
+    GLState::polygonMode(GL_FILL);
+    for (size_t i = 0; i < packets.size(); i++) {
+      const DrawPacket &p = packets[i];
+      if (p.shader != shader) {
+        shader = p.shader;
+        shader->use();
+        stats.programChanges++;
+      }
+      if (p.indirect) {
+        size_t end = i + 1;
+        while (end < packets.size() && packets[end].indirect &&
+               packets[end].shader == p.shader &&
+               (packets[end].key >> 60) == (p.key >> 60) &&
+               sameMaterial(packets[end], p))
+          end++;
+        drawIndirect(ring, i, end);
+        i = end - 1;
+        object = UINT32_MAX;
+        continue;
+      }
+      // a full ring leaves the previous object's ranges bound, so the draw
+      // would go out with its matrix or palette
+      const RenderObject &o = objects[p.object];
+      if (o.bones && !o.palette.valid()) {
+        stats.dropped++;
+        continue;
+      }
+      if (p.object != object) {
+        object = p.object;
+        if (o.bones)
+          ring.bind(UniformRing::BONES, o.palette);
+        stats.objectChanges++;
+      }
+      ObjectBlock block{transforms[p.transform], o.isHit, p.layer, 0, p.bone};
+      UniformRing::Range blockRange = ring.push(block);
+      if (!blockRange.valid()) {
+        stats.dropped++;
+        continue;
+      }
+      ring.bind(UniformRing::DRAW, blockRange);
+      for (uint32_t i = 0; i < p.materialCount; i++)
+        GLState::bindTexture(p.material[i].unit, p.material[i].target,
+                             p.material[i].texture);
+      GLState::bindVertexArray(p.vao);
+      glDrawElementsBaseVertex(
+          GL_TRIANGLES, p.indexCount, GL_UNSIGNED_INT,
+          (const void *)(size_t)(p.firstIndex * sizeof(unsigned int)),
+          p.baseVertex);
+    }
+  }
+
+private:
+  struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+  };
+
+  glm::mat4 view{1.0f};
+  float farPlane = 100.0f;
+  UniformRing *ring = nullptr;
+  MeshPool *pool = nullptr;
+
+  uint32_t addTransform(const Mesh &mesh, const glm::mat4 &transform) {
+    transforms.push_back(transform);
+    TextureStreamer::instance().touch(mesh, transform);
+    return (uint32_t)transforms.size() - 1;
+  }
+
+  void push(Shader &shader, Mesh &mesh, const Mesh::SkinGroup &group,
+            uint32_t transform, uint32_t object, Layer layer) {
+    const Mesh::MaterialTable &material = mesh.materialFor(shader);
+
+    glm::vec4 viewPos = view * transforms[transform][3];
+    float depth = std::max(-viewPos.z, 0.0f);
+    uint64_t depthBits =
+        (uint64_t)(std::min(depth / farPlane, 1.0f) * 0xFFFFFF) & 0xFFFFFF;
+    uint64_t materialBits = material.sortKey & 0xFFFF;
+
+    DrawPacket packet;
+    packet.key = ((uint64_t)layer << 60) |
+                 ((uint64_t)(shader.ID & 0xFFF) << 48) | (materialBits << 32) |
+                 ((uint64_t)(object & 0xFF) << 24) | depthBits;
+    packet.shader = &shader;
+    packet.vao = mesh.VAO;
+    packet.indexCount = group.indexCount;
+    packet.firstIndex = mesh.firstIndex + group.firstIndex;
+    packet.baseVertex = mesh.baseVertex;
+    packet.material = material.bindings.data();
+    packet.materialCount = (uint32_t)material.bindings.size();
+    packet.layer = mesh.diffuseLayer;
+    packet.bone = group.bone;
+    packet.indirect = false;
+    packet.transform = transform;
+    packet.object = object;
+    packet.depth = depth;
+    packets.push_back(packet);
+  }
+
+  static bool sameMaterial(const DrawPacket &a, const DrawPacket &b) {
+    if (a.materialCount != b.materialCount)
+      return false;
+    for (uint32_t i = 0; i < a.materialCount; i++)
+      if (a.material[i].texture != b.material[i].texture ||
+          a.material[i].target != b.material[i].target)
+        return false;
+    return true;
+  }
+
+  // packets [first, last) share shader and textures
+  void drawIndirect(UniformRing &ring, size_t first, size_t last) {
+    static std::vector<ObjectBlock> draws;
+    static std::vector<DrawElementsIndirectCommand> commands;
+    draws.clear();
+    commands.clear();
+    for (size_t i = first; i < last; i++) {
+      const DrawPacket &p = packets[i];
+      draws.push_back({transforms[p.transform], objects[p.object].isHit,
+                       p.layer, 0, 0});
+      // baseInstance is the draw id the shader indexes the blocks with
+      commands.push_back({(GLuint)p.indexCount, 1, p.firstIndex, p.baseVertex,
+                          (GLuint)(i - first)});
+    }
+
+    const DrawPacket &p = packets[first];
+    for (uint32_t i = 0; i < p.materialCount; i++)
+      GLState::bindTexture(p.material[i].unit, p.material[i].target,
+                           p.material[i].texture);
+    pool->reserveDrawIds(draws.size());
+    UniformRing::Range drawRange =
+        ring.push(draws.data(), draws.size() * sizeof(ObjectBlock));
+    UniformRing::Range commandRange = ring.push(
+        commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+    if (!drawRange.valid() || !commandRange.valid()) {
+      stats.dropped += (int)commands.size();
+      return;
+    }
+    ring.bindStorage(DRAW_DATA_BINDING, drawRange);
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.id());
+    GLState::bindVertexArray(pool->vao());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                (const void *)commandRange.offset,
+                                (GLsizei)commands.size(), 0);
+    stats.indirectDraws++;
+    stats.indirectCommands += (int)commands.size();
+  }
+};
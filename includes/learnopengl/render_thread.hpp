@@ -0,0 +1,151 @@
+#pragma once
+#include "learnopengl/cpu_profiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs the GL half of every frame on a thread of its own.
+//
+// The main thread simulates frame N and records what it wants drawn into a
+// Frame slot: record() hands out the slot, submit() passes it on. The render
+// thread, which owns the GL context, replays it through the callback while
+// the main thread already simulates frame N + 1. So the CPU frame time is
+// max(simulation, rendering) instead of their sum.
+//
+// The pipeline is one frame deep: record() for frame N waits until frame
+// N - 2 was rendered. There are three slots, one being recorded, one being
+// rendered and the last finished one. The callback may write results into
+// its frame, e.g. statistics, and the main thread reads them back through
+// finished() while it records a later frame.
+//
+// A Frame must hold copies of everything the callback reads, because the
+// simulation changes its own state meanwhile. The callback must be the only
+// code that touches render-side state (GL objects, queues, profilers).
+//
+// Without start() there is no thread: submit() runs the callback itself
+// before it returns, e.g. for benchmark runs.
+template <typename Frame> class RenderThread {
+public:
+  static const int FRAMES = 3;
+
+  struct Stats {
+    double recordWaitMs = 0.0; // main thread, waiting for a free slot
+    double renderWaitMs = 0.0; // render thread, waiting for a frame
+  };
+
+  explicit RenderThread(std::function<void(Frame &)> render)
+      : render(std::move(render)) {}
+
+  ~RenderThread() { stop(); }
+
+  // `attach` runs on the new thread before the first frame (make the GL
+  // context current there), `detach` after the last one (release it)
+  void start(std::function<void()> attach, std::function<void()> detach) {
+    thread = std::thread([this, attach, detach] {
+      profilerThread = (int)CpuProfiler::threadId();
+      attach();
+      run();
+      detach();
+    });
+  }
+
+  bool threaded() const { return thread.joinable(); }
+
+  // CpuProfiler::threadId() of the render thread, -1 until it runs
+  int profilerId() const { return profilerThread; }
+
+  // the slot to record the next frame into
+  Frame &record() {
+    PROFILE_ZONE("RenderThread::record");
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return rendered + 1 >= recorded; });
+    stats.recordWaitMs = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    stats.renderWaitMs = renderWaitMs;
+    latest = rendered;
+    return frames[recorded % FRAMES];
+  }
+
+  // the last frame rendered when record() was called, nullptr before the
+  // first; stays untouched until the next submit()
+  const Frame *finished() const {
+    return latest > 0 ? &frames[(latest - 1) % FRAMES] : nullptr;
+  }
+
+  const Stats &frameStats() const { return stats; }
+
+  // passes the recorded frame to the render thread
+  void submit() {
+    if (!threaded()) {
+      render(frames[recorded % FRAMES]);
+      recorded++;
+      rendered++;
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      recorded++;
+    }
+    ready.notify_one();
+  }
+
+  // renders every submitted frame, then ends the thread
+  void stop() {
+    if (!threaded())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    ready.notify_one();
+    thread.join();
+  }
+
+private:
+  std::function<void(Frame &)> render;
+  Frame frames[FRAMES];
+  std::thread thread;
+  std::atomic<int> profilerThread{-1};
+  std::mutex mutex;
+  std::condition_variable ready; // a frame was submitted, or stop()
+  std::condition_variable idle;  // a frame was rendered
+  uint64_t recorded = 0;         // submitted frames, guarded by mutex
+  uint64_t rendered = 0;         // guarded by mutex
+  bool stopping = false;         // guarded by mutex
+  double renderWaitMs = 0.0;     // guarded by mutex
+  uint64_t latest = 0;           // main thread
+  Stats stats;                   // main thread
+
+  void run() {
+    for (;;) {
+      uint64_t frame;
+      {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return stopping || rendered < recorded; });
+        if (rendered == recorded)
+          return;
+        renderWaitMs = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        frame = rendered;
+      }
+      {
+        PROFILE_ZONE("RenderThread::render");
+        render(frames[frame % FRAMES]);
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        rendered++;
+      }
+      idle.notify_one();
+    }
+  }
+};
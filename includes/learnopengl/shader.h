@@ -3,15 +3,39 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <learnopengl/gl_state.hpp>
+#include <learnopengl/program_cache.hpp>
 
 #include <string>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 class Shader
 {
 public:
+    // handle into the uniform table reflected after link; resolve it once with
+    // uniform() and pass it to set() to skip the name lookup entirely
+    struct Uniform
+    {
+        int slot = -1;
+        bool valid() const { return slot >= 0; }
+    };
+
+    // sources already in memory; `defines` goes right after the #version line
+    // of both stages (see ShaderVariants)
+    struct Sources
+    {
+        std::string vertex;
+        std::string fragment;
+        std::string defines;
+    };
+
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
@@ -57,114 +81,373 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        build(vertexCode, fragmentCode, geometryPath != nullptr ? &geometryCode : nullptr);
+    }
+    explicit Shader(const Sources &sources)
+    {
+        build(withDefines(sources.vertex, sources.defines), withDefines(sources.fragment, sources.defines), nullptr);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::useProgram(ID);
+    }
+    // uniform lookup
+    // ------------------------------------------------------------------------
+    Uniform uniform(const std::string &name) const
+    {
+        auto it = uniforms->byName.find(name);
+        return it != uniforms->byName.end() ? Uniform{it->second} : Uniform{};
+    }
+    // texture unit assigned to a sampler at link time, -1 if it is not active
+    int samplerUnit(const std::string &name) const
+    {
+        Uniform u = uniform(name);
+        return u.valid() ? uniforms->slots[u.slot].unit : -1;
+    }
+    int samplerUnits() const { return uniforms->samplerUnits; }
+    // index of an active uniform block, GL_INVALID_INDEX if it was optimised out
+    GLuint uniformBlock(const std::string &name) const
+    {
+        auto it = uniforms->blocks.find(name);
+        return it != uniforms->blocks.end() ? it->second : GL_INVALID_INDEX;
+    }
+    // reads the block from an indexed GL_UNIFORM_BUFFER binding point; no-op
+    // if the program has no such active block
+    void bindBlock(const std::string &name, GLuint binding) const
+    {
+        GLuint index = uniformBlock(name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // uploads issued vs. skipped because the program already held the value
+    unsigned long long uniformUploads() const { return uniforms->uploads; }
+    unsigned long long uniformsSkipped() const { return uniforms->skipped; }
+    // handle based setters, the program must be in use
+    // ------------------------------------------------------------------------
+    void set(Uniform u, int value) const
+    {
+        if (changed(u, &value, sizeof(value)))
+            glUniform1i(location(u), value);
+    }
+    void set(Uniform u, bool value) const
+    {
+        set(u, (int)value);
+    }
+    void set(Uniform u, float value) const
+    {
+        if (changed(u, &value, sizeof(value)))
+            glUniform1f(location(u), value);
+    }
+    void set(Uniform u, const glm::vec2 &value) const
+    {
+        if (changed(u, &value, sizeof(value)))
+            glUniform2fv(location(u), 1, &value[0]);
+    }
+    void set(Uniform u, const glm::vec3 &value) const
+    {
+        if (changed(u, &value, sizeof(value)))
+            glUniform3fv(location(u), 1, &value[0]);
+    }
+    void set(Uniform u, const glm::vec4 &value) const
+    {
+        if (changed(u, &value, sizeof(value)))
+            glUniform4fv(location(u), 1, &value[0]);
+    }
+    void set(Uniform u, const glm::ivec4 &value) const
+    {
+        if (changed(u, &value, sizeof(value)))
+            glUniform4iv(location(u), 1, &value[0]);
+    }
+    void set(Uniform u, const glm::mat2 &mat) const
+    {
+        if (changed(u, &mat, sizeof(mat)))
+            glUniformMatrix2fv(location(u), 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform u, const glm::mat3 &mat) const
+    {
+        if (changed(u, &mat, sizeof(mat)))
+            glUniformMatrix3fv(location(u), 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform u, const glm::mat4 &mat) const
+    {
+        if (changed(u, &mat, sizeof(mat)))
+            glUniformMatrix4fv(location(u), 1, GL_FALSE, &mat[0][0]);
+    }
+    // uploads `count` matrices starting at array element `first` in one call,
+    // or nothing at all when none of them changed
+    void setArray(Uniform first, const glm::mat4 *mats, int count) const
+    {
+        if (!first.valid())
+            return;
+        count = std::min(count, uniforms->slots[first.slot].remaining);
+        bool dirty = false;
+        for (int i = 0; i < count; i++)
+            dirty |= changed(Uniform{first.slot + i}, &mats[i], sizeof(glm::mat4));
+        if (dirty)
+            glUniformMatrix4fv(location(first), count, GL_FALSE, &mats[0][0][0]);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        set(uniform(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        set(uniform(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        set(uniform(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4Array(const std::string &name, const std::vector<glm::mat4> &mats) const
+    {
+        if (!mats.empty())
+            setArray(uniform(name), mats.data(), (int)mats.size());
     }
 
 private:
+    void build(const std::string &vertexCode, const std::string &fragmentCode, const std::string *geometryCode)
+    {
+        // 2. try the program binary cache before touching the compiler; the
+        // key holds the defines too, so every variant gets its own entry
+        std::string cacheKey = vertexCode + '\0' + fragmentCode + '\0' + (geometryCode ? *geometryCode : std::string());
+        ID = glCreateProgram();
+        if (!ProgramCache::load(ID, cacheKey))
+        {
+            // cache miss or stale entry: start again from a fresh program object
+            glDeleteProgram(ID);
+            ID = glCreateProgram();
+            compile(vertexCode, fragmentCode, geometryCode);
+            ProgramCache::prepare(ID);
+            glLinkProgram(ID);
+            if (checkCompileErrors(ID, "PROGRAM"))
+                ProgramCache::store(ID, cacheKey);
+        }
+        // 4. resolve every active uniform once instead of on each set*() call
+        reflect();
+    }
+    // inserts `defines` after the #version line and renumbers what follows, so
+    // compile errors still point at the line in the file
+    static std::string withDefines(const std::string &code, const std::string &defines)
+    {
+        if (defines.empty())
+            return code;
+        size_t version = code.find("#version");
+        size_t end = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if (end == std::string::npos)
+            return defines + code;
+        int line = 2 + (int)std::count(code.begin(), code.begin() + end, '\n');
+        return code.substr(0, end + 1) + defines + "#line " + std::to_string(line) + "\n" + code.substr(end + 1);
+    }
+    // one entry per active uniform (per element for arrays) with the last value
+    // uploaded, so repeated sets of an unchanged value never reach the driver
+    struct UniformSlot
+    {
+        GLint location = -1;
+        GLenum type = 0;
+        int remaining = 1; // array elements from this one to the end
+        int unit = -1;     // fixed texture unit for samplers
+        bool cached = false;
+        unsigned char value[sizeof(glm::mat4)];
+    };
+    struct UniformTable
+    {
+        std::vector<UniformSlot> slots;
+        std::unordered_map<std::string, int> byName;
+        std::unordered_map<std::string, GLuint> blocks;
+        unsigned long long uploads = 0, skipped = 0;
+        int samplerUnits = 0;
+    };
+    // shared so copies of a Shader agree on what the program currently holds
+    std::shared_ptr<UniformTable> uniforms = std::make_shared<UniformTable>();
+
+    GLint location(Uniform u) const
+    {
+        return uniforms->slots[u.slot].location;
+    }
+    // records the value and returns true if it has to be uploaded
+    bool changed(Uniform u, const void *data, size_t size) const
+    {
+        if (!u.valid())
+            return false;
+        UniformSlot &slot = uniforms->slots[u.slot];
+        if (slot.cached && std::memcmp(slot.value, data, size) == 0)
+        {
+            uniforms->skipped++;
+            return false;
+        }
+        std::memcpy(slot.value, data, size);
+        slot.cached = true;
+        uniforms->uploads++;
+        return true;
+    }
+    // enumerate active uniforms and uniform blocks after link
+    // ------------------------------------------------------------------------
+    void reflect()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint loc = glGetUniformLocation(ID, name.c_str());
+            if (loc < 0)
+                continue; // lives in a uniform block
+            // arrays report "name[0]"; register the bare name and every element
+            std::string base = name;
+            if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+                base.resize(base.size() - 3);
+            for (GLint e = 0; e < size; e++)
+            {
+                UniformSlot slot;
+                slot.type = type;
+                slot.remaining = size - e;
+                slot.location = e == 0 ? loc : glGetUniformLocation(ID, (base + "[" + std::to_string(e) + "]").c_str());
+                uniforms->byName[size > 1 ? base + "[" + std::to_string(e) + "]" : name] = (int)uniforms->slots.size();
+                uniforms->slots.push_back(slot);
+            }
+            uniforms->byName.emplace(base, uniforms->byName[size > 1 ? base + "[0]" : name]);
+        }
+
+        // every sampler gets its own unit for the lifetime of the program, so
+        // draws only bind textures and never touch sampler uniforms again
+        int units = 0;
+        for (UniformSlot &slot : uniforms->slots)
+            if (isSampler(slot.type))
+                slot.unit = units++;
+        uniforms->samplerUnits = units;
+        if (units > 0)
+        {
+            GLint previous = 0;
+            glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+            GLState::useProgram(ID);
+            for (size_t i = 0; i < uniforms->slots.size(); i++)
+                if (uniforms->slots[i].unit >= 0)
+                    set(Uniform{(int)i}, uniforms->slots[i].unit);
+            GLState::useProgram(previous);
+        }
+
+        GLint blocks = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+        for (GLint i = 0; i < blocks; i++)
+        {
+            GLchar blockName[256];
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(ID, (GLuint)i, sizeof(blockName), &length, blockName);
+            uniforms->blocks[std::string(blockName, length)] = (GLuint)i;
+        }
+    }
+    static bool isSampler(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT:
+        case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+        default:
+            return false;
+        }
+    }
+    // ------------------------------------------------------------------------
+    void compile(const std::string &vertexCode, const std::string &fragmentCode, const std::string *geometryCode)
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        // 3. compile shaders
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        // if geometry shader is given, compile geometry shader
+        unsigned int geometry;
+        if(geometryCode != nullptr)
+        {
+            const char * gShaderCode = geometryCode->c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+            checkCompileErrors(geometry, "GEOMETRY");
+        }
+        // shader Program
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if(geometryCode != nullptr)
+            glAttachShader(ID, geometry);
+        // the shaders stay attached for the link and are freed with the program
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        if(geometryCode != nullptr)
+            glDeleteShader(geometry);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -186,6 +469,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
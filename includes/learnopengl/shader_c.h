@@ -3,6 +3,7 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <learnopengl/gl_state.hpp>
 
 #include <string>
 #include <fstream>
@@ -60,7 +61,7 @@ public:
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::useProgram(ID); 
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
@@ -79,6 +80,11 @@ public:
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
     }
     // ------------------------------------------------------------------------
+    void setIVec2(const std::string &name, const glm::ivec2 &value) const
+    { 
+        glUniform2iv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    }
+    // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
         glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
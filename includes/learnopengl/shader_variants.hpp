@@ -0,0 +1,97 @@
+#pragma once
+#include "learnopengl/shader.h"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+// Feature bits of a shader variant. Each one becomes a #define of the same
+// name in both stages; a family's sources test them with #ifdef, so a
+// variant carries no branch for a feature it lacks.
+namespace ShaderFeature {
+
+enum : uint32_t {
+  SKINNED = 1 << 0,       // blend vertices by up to four bones
+  INSTANCED = 1 << 1,     // per-instance records (InstancedModel)
+  INDIRECT = 1 << 2,      // per-draw records of a multi-draw (RenderQueue)
+  HIT_FLASH = 1 << 3,     // the whole draw flashes white
+  TEXTURE_ARRAY = 1 << 4, // diffuse map is a layer of a texture array
+  ALPHA_TEST = 1 << 5,    // discard texels below half alpha (cutouts)
+  // with SKINNED, for the triangle groups of Mesh::skinGroups
+  RIGID = 1 << 6,        // every vertex follows the draw's one bone
+  INFLUENCES_1 = 1 << 7, // at most one bone per vertex
+  INFLUENCES_2 = 1 << 8, // at most two
+};
+
+const int COUNT = 9;
+
+inline const char *name(int bit) {
+  static const char *names[COUNT] = {
+      "SKINNED",    "INSTANCED", "INDIRECT",     "HIT_FLASH",   "TEXTURE_ARRAY",
+      "ALPHA_TEST", "RIGID",     "INFLUENCES_1", "INFLUENCES_2"};
+  return names[bit];
+}
+
+inline std::string defines(uint32_t features) {
+  std::string result;
+  for (int bit = 0; bit < COUNT; bit++)
+    if (features & (1u << bit))
+      result += std::string("#define ") + name(bit) + "\n";
+  return result;
+}
+
+} // namespace ShaderFeature
+
+// One vertex/fragment source pair compiled into a program per combination
+// of ShaderFeature bits, so features add #ifdef blocks instead of files.
+//
+// get() compiles a variant the first time its key is asked for and keeps it
+// for the lifetime of the family; precompile() does the same ahead of time,
+// e.g. at load, so no frame pays for a compile. Each variant's sources
+// include its defines, so the ProgramCache stores a binary per variant and
+// later runs only relink from disk.
+class ShaderVariants {
+public:
+  // `setup` runs on every new variant, e.g. UniformRing::bindBlocks
+  ShaderVariants(const char *vertexPath, const char *fragmentPath,
+                 std::function<void(Shader &)> setup = nullptr)
+      : vertexCode(read(vertexPath)), fragmentCode(read(fragmentPath)),
+        setup(std::move(setup)) {}
+
+  Shader &get(uint32_t features) {
+    auto it = variants.find(features);
+    if (it != variants.end())
+      return *it->second;
+    auto shader = std::make_unique<Shader>(Shader::Sources{
+        vertexCode, fragmentCode, ShaderFeature::defines(features)});
+    if (setup)
+      setup(*shader);
+    return *(variants[features] = std::move(shader));
+  }
+
+  void precompile(uint32_t features) { get(features); }
+
+  size_t compiled() const { return variants.size(); }
+
+private:
+  std::string vertexCode, fragmentCode;
+  std::function<void(Shader &)> setup;
+  std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants;
+
+  static std::string read(const char *path) {
+    std::ifstream file(path);
+    if (!file) {
+      std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path
+                << std::endl;
+      return "";
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
+  }
+};
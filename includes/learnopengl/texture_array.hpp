@@ -0,0 +1,106 @@
+#pragma once
+#include <glad/glad.h>
+#include <learnopengl/gl_state.hpp>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Packs loaded 2D textures that share internal format, size and mip count into
+// GL_TEXTURE_2D_ARRAYs so meshes that only differ in their map can be drawn
+// with the same binding. Copies happen on the GPU with glCopyImageSubData, so
+// this needs GL 4.3; without it pack() returns nothing and meshes keep their
+// 2D textures.
+namespace TextureArrays {
+
+struct Layer {
+  GLuint array = 0;
+  int layer = -1;
+};
+
+inline bool supported() { return GLAD_GL_VERSION_4_3 != 0; }
+
+// glTexStorage needs a sized format; some drivers report the unsized one that
+// was passed to glTexImage2D
+inline GLenum sizedFormat(GLint format) {
+  switch (format) {
+  case GL_RED:
+    return GL_R8;
+  case GL_RG:
+    return GL_RG8;
+  case GL_RGB:
+    return GL_RGB8;
+  case GL_RGBA:
+    return GL_RGBA8;
+  default:
+    return (GLenum)format;
+  }
+}
+
+// Returns where each input texture ended up. The source textures are deleted
+// once copied.
+inline std::unordered_map<GLuint, Layer>
+pack(const std::vector<GLuint> &textures) {
+  std::unordered_map<GLuint, Layer> result;
+  if (!supported())
+    return result;
+
+  using Key = std::tuple<GLenum, GLint, GLint, GLint>; // format, w, h, levels
+  std::map<Key, std::vector<GLuint>> groups;
+  for (GLuint texture : textures) {
+    if (texture == 0 || result.count(texture))
+      continue;
+    GLState::bindTexture(GL_TEXTURE_2D, texture);
+    GLint width = 0, height = 0, format = 0, maxLevel = 1000;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT,
+                             &format);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    if (width == 0 || height == 0)
+      continue;
+    GLint levels = 1;
+    while (levels <= maxLevel && (std::max(width, height) >> levels) > 0)
+      levels++;
+    groups[{sizedFormat(format), width, height, levels}].push_back(texture);
+    result[texture] = Layer(); // placeholder so duplicates are skipped
+  }
+
+  for (auto &[key, members] : groups) {
+    auto [format, width, height, levels] = key;
+    GLuint array = 0;
+    glGenTextures(1, &array);
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, array);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format, width, height,
+                   (GLsizei)members.size());
+    for (size_t layer = 0; layer < members.size(); layer++) {
+      for (GLint level = 0; level < levels; level++) {
+        GLsizei w = std::max(1, width >> level);
+        GLsizei h = std::max(1, height >> level);
+        glCopyImageSubData(members[layer], GL_TEXTURE_2D, level, 0, 0, 0, array,
+                           GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint)layer, w, h,
+                           1);
+      }
+      result[members[layer]] = {array, (int)layer};
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+
+  // the copies are complete from the GL point of view, drop the originals
+  for (auto &[texture, layer] : result) {
+    if (layer.array != 0) {
+      GLuint id = texture;
+      glDeleteTextures(1, &id);
+    }
+  }
+  GLState::invalidate(); // deleted textures may still sit in the cache
+  return result;
+}
+
+} // namespace TextureArrays
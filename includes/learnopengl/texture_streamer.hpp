@@ -0,0 +1,354 @@
+#pragma once
+#include "learnopengl/baked_asset.hpp"
+#include "learnopengl/cpu_profiler.hpp"
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/mesh.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Mip residency of baked textures (hk_bake's cache/baked files, which hold
+// the whole mip chain) under a VRAM budget.
+//
+// load() creates a texture with only its small mips, those no larger than
+// FLOOR texels, and hides the missing levels with GL_TEXTURE_BASE_LEVEL.
+// RenderQueue and InstancedModel touch() every mesh they queue; the
+// projected size of its bounds gives the finest level worth having (one
+// texel per pixel, assuming the UVs span the texture once), and the largest
+// request of the frame wins. update() then has the worker threads read the
+// next finer level of every texture short of its wanted level from the
+// baked file, and uploads what they finished, at most UPLOAD_BYTES a frame.
+//
+// Past the budget, textures drop their finest level (a zero-sized
+// glTexImage2D frees it), least recently used first, but never below the
+// floor. A level is only streamed in if the room can be made from textures
+// that were not used this frame. The floor levels count against the budget
+// too, so a budget smaller than them all streams nothing in.
+//
+// Textures that are not baked, and the texture arrays Model builds, are
+// uploaded whole as before and not counted against the budget.
+class TextureStreamer {
+public:
+  // levels up to this size stay resident
+  static const uint32_t FLOOR = 64;
+  static const size_t UPLOAD_BYTES = 8 << 20;
+  static const int WORKERS = 2;
+
+  struct Info {
+    GLuint id;
+    std::string path;
+    uint32_t width, height; // of level 0
+    int base;   // finest resident level, the mip bias
+    int wanted; // finest level the last frame asked for
+    int floor;  // coarsest level that is ever dropped to
+    size_t bytes;
+    unsigned long long lastUsed;
+    bool loading;
+  };
+
+  struct Stats {
+    size_t resident = 0; // bytes of streamed textures on the GPU
+    size_t budget = 0;
+    int textures = 0;
+    int uploads = 0;   // this frame
+    int evictions = 0; // this frame
+    int pending = 0;   // levels requested and not uploaded yet
+  };
+
+  bool enabled = false;
+  size_t budget = 256u << 20;
+
+  static TextureStreamer &instance() {
+    static TextureStreamer streamer;
+    return streamer;
+  }
+
+  ~TextureStreamer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  // Creates a streamed texture from a baked file. Returns 0 when streaming
+  // is off or the file is unusable (see BakedAssets::loadTexture), so the
+  // caller can load it whole instead.
+  GLuint load(const std::string &path, bool flipped,
+              const std::string &source = "") {
+    BakedAssets::TextureIndex index;
+    if (!enabled || !BakedAssets::upToDate(path, source) ||
+        !BakedAssets::readTextureIndex(path, index) ||
+        index.flipped != (uint32_t)flipped)
+      return 0;
+
+    Entry entry;
+    entry.path = path;
+    entry.index = index;
+    entry.floor = (int)index.levels.size() - 1;
+    while (entry.floor > 0 &&
+           std::max(index.levels[entry.floor - 1].width,
+                    index.levels[entry.floor - 1].height) <= FLOOR)
+      entry.floor--;
+
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    GLState::bindTexture(GL_TEXTURE_2D, id);
+    std::vector<unsigned char> data;
+    for (int level = entry.floor; level < (int)index.levels.size(); level++) {
+      const BakedAssets::TextureLevelEntry &l = index.levels[level];
+      if (!BakedAssets::readTextureLevel(path, l, data)) {
+        glDeleteTextures(1, &id);
+        GLState::invalidate();
+        return 0;
+      }
+      BakedAssets::uploadLevel(index.format, index.channels, level, l.width,
+                               l.height, data);
+      entry.bytes += l.size;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.floor);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                    (GLint)index.levels.size() - 1);
+    BakedAssets::setSampling();
+    entry.base = entry.wanted = entry.floor;
+    stats.resident += entry.bytes;
+    entries[id] = std::move(entry);
+    return id;
+  }
+
+  bool streamed(GLuint id) const { return entries.count(id) != 0; }
+
+  // `pixelsPerUnit` is the viewport height over 2 tan(fovy / 2): the size in
+  // pixels of one world unit at distance 1
+  void beginFrame(const glm::vec3 &cameraPos, float pixelsPerUnit) {
+    frame++;
+    camera = cameraPos;
+    this->pixelsPerUnit = pixelsPerUnit;
+  }
+
+  // `mesh` is drawn this frame with `transform`
+  void touch(const Mesh &mesh, const glm::mat4 &transform) {
+    if (entries.empty())
+      return;
+    glm::vec3 center = 0.5f * (mesh.mAABB.mMin + mesh.mAABB.mMax);
+    glm::vec3 half = 0.5f * (mesh.mAABB.mMax - mesh.mAABB.mMin);
+    float scale = std::max({glm::length(glm::vec3(transform[0])),
+                            glm::length(glm::vec3(transform[1])),
+                            glm::length(glm::vec3(transform[2]))});
+    float radius = glm::length(half) * scale;
+    glm::vec3 world = glm::vec3(transform * glm::vec4(center, 1.0f));
+    float distance = std::max(glm::length(world - camera) - radius, 0.1f);
+    float pixels = 2.0f * radius * pixelsPerUnit / distance;
+    for (const Texture &texture : mesh.textures) {
+      auto it = entries.find(texture.id);
+      if (it == entries.end())
+        continue;
+      it->second.lastUsed = frame;
+      it->second.pixels = std::max(it->second.pixels, pixels);
+    }
+  }
+
+  // call once per frame after the draws were queued; needs the GL context
+  void update() {
+    PROFILE_ZONE("TextureStreamer::update");
+    stats.uploads = 0;
+    stats.evictions = 0;
+    upload();
+
+    for (auto &[id, entry] : entries) {
+      entry.wanted =
+          entry.lastUsed == frame ? levelFor(entry, entry.pixels) : entry.floor;
+      entry.pixels = 0.0f;
+      if (entry.wanted < entry.base && !entry.loading &&
+          makeRoom(entry.index.levels[entry.base - 1].size, frame))
+        request(id, entry);
+    }
+
+    // the budget may have shrunk: now even textures in view give way
+    while (stats.resident > budget && makeRoom(0, frame + 1)) {
+    }
+
+    stats.budget = budget;
+    stats.textures = (int)entries.size();
+  }
+
+  const Stats &frameStats() const { return stats; }
+
+  std::vector<Info> textures() const {
+    std::vector<Info> result;
+    for (const auto &[id, entry] : entries)
+      result.push_back({id, entry.path, entry.index.levels[0].width,
+                        entry.index.levels[0].height, entry.base, entry.wanted,
+                        entry.floor, entry.bytes, entry.lastUsed,
+                        entry.loading});
+    std::sort(result.begin(), result.end(),
+              [](const Info &a, const Info &b) { return a.bytes > b.bytes; });
+    return result;
+  }
+
+private:
+  struct Entry {
+    std::string path;
+    BakedAssets::TextureIndex index;
+    int base = 0, wanted = 0, floor = 0;
+    size_t bytes = 0; // resident levels
+    unsigned long long lastUsed = 0;
+    float pixels = 0.0f; // largest projected size this frame
+    bool loading = false;
+  };
+
+  struct Job {
+    GLuint id;
+    int level;
+    std::string path;
+    BakedAssets::TextureLevelEntry entry;
+  };
+
+  struct Result {
+    GLuint id;
+    int level;
+    bool ok;
+    std::vector<unsigned char> data;
+  };
+
+  std::unordered_map<GLuint, Entry> entries;
+  unsigned long long frame = 0;
+  glm::vec3 camera{0.0f};
+  float pixelsPerUnit = 1.0f;
+  Stats stats;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Job> jobs;       // guarded by mutex
+  std::deque<Result> results; // guarded by mutex
+  bool stopping = false;      // guarded by mutex
+
+  TextureStreamer() = default;
+
+  int levelFor(const Entry &entry, float pixels) const {
+    const BakedAssets::TextureLevelEntry &top = entry.index.levels[0];
+    float texels = (float)std::max(top.width, top.height);
+    int level = (int)std::floor(std::log2(texels / std::max(pixels, 1.0f)));
+    return std::clamp(level, 0, entry.floor);
+  }
+
+  void request(GLuint id, Entry &entry) {
+    if (workers.empty())
+      for (int i = 0; i < WORKERS; i++)
+        workers.emplace_back([this] { work(); });
+    entry.loading = true;
+    stats.pending++;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back({id, entry.base - 1, entry.path,
+                      entry.index.levels[entry.base - 1]});
+    }
+    wake.notify_one();
+  }
+
+  void work() {
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping)
+          return;
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      PROFILE_ZONE("TextureStreamer::read");
+      Result result{job.id, job.level, false, {}};
+      result.ok =
+          BakedAssets::readTextureLevel(job.path, job.entry, result.data);
+      std::lock_guard<std::mutex> lock(mutex);
+      results.push_back(std::move(result));
+    }
+  }
+
+  // uploads finished levels, up to UPLOAD_BYTES; the rest waits a frame
+  void upload() {
+    size_t uploaded = 0;
+    for (;;) {
+      Result result;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (results.empty() || uploaded >= UPLOAD_BYTES)
+          return;
+        result = std::move(results.front());
+        results.pop_front();
+      }
+      stats.pending--;
+      auto it = entries.find(result.id);
+      if (it == entries.end())
+        continue;
+      Entry &entry = it->second;
+      entry.loading = false;
+      const BakedAssets::TextureLevelEntry &level =
+          entry.index.levels[result.level];
+      // dropped or evicted meanwhile, or the room is gone
+      if (!result.ok || result.level != entry.base - 1 ||
+          result.level < entry.wanted || !makeRoom(level.size, frame))
+        continue;
+      GLState::bindTexture(GL_TEXTURE_2D, result.id);
+      BakedAssets::uploadLevel(entry.index.format, entry.index.channels,
+                               result.level, level.width, level.height,
+                               result.data);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, result.level);
+      entry.base = result.level;
+      entry.bytes += level.size;
+      stats.resident += level.size;
+      uploaded += level.size;
+      stats.uploads++;
+    }
+  }
+
+  // Drops finest levels of textures last used before `before` until `bytes`
+  // more fit in the budget. False when that is not possible.
+  bool makeRoom(size_t bytes, unsigned long long before) {
+    while (stats.resident + bytes > budget) {
+      Entry *victim = nullptr;
+      GLuint victimId = 0;
+      for (auto &[id, entry] : entries) {
+        if (entry.base >= entry.floor || entry.loading ||
+            entry.lastUsed >= before)
+          continue;
+        if (!victim || entry.lastUsed < victim->lastUsed) {
+          victim = &entry;
+          victimId = id;
+        }
+      }
+      if (!victim)
+        return false;
+      drop(victimId, *victim);
+    }
+    return true;
+  }
+
+  void drop(GLuint id, Entry &entry) {
+    const BakedAssets::TextureLevelEntry &level =
+        entry.index.levels[entry.base];
+    GLState::bindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.base + 1);
+    // below the base level the image is never sampled, so it can go
+    glTexImage2D(GL_TEXTURE_2D, entry.base, GL_RGBA8, 0, 0, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    entry.base++;
+    entry.bytes -= level.size;
+    stats.resident -= level.size;
+    stats.evictions++;
+  }
+};
@@ -0,0 +1,247 @@
+#pragma once
+#include "learnopengl/gl_state.hpp"
+#include "learnopengl/shader.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// std140 blocks shared by several shaders. Every shader declares the blocks
+// it reads itself (GLSL has no #include), so a change here has to be mirrored
+// in the .vert/.frag files.
+//
+//   layout(std140) uniform Frame { mat4 view; mat4 projection;
+//                                  vec3 cameraPos; float time; };
+struct FrameBlock {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 cameraPos;
+  float time;
+};
+
+//   layout(std140) uniform Draw { mat4 model; int isHit; int diffuseLayer;
+//                                 int instanceBase; int rigidBone; };
+// texturedModel.vert; INSTANCED variants only read the last three
+struct ObjectBlock {
+  glm::mat4 model;
+  int isHit;
+  int diffuseLayer;
+  int instanceBase;
+  int rigidBone; // RIGID variants, see Mesh::SkinGroup
+};
+
+// Per-frame ring of uniform data, bound to the shaders by offset.
+//
+// Draws no longer set their constants with glUniform*: they push a std140
+// struct into the ring and bind that range to a uniform block binding point
+// with glBindBufferRange. The buffer is split into FRAMES regions, one per
+// frame in flight; endFrame() puts a fence behind the frame's draws and
+// beginFrame() waits on the fence of the region it is about to reuse, which
+// the GPU finished FRAMES - 1 frames ago, so in practice it never blocks.
+//
+// With GL 4.4 the buffer is created with glBufferStorage and mapped once,
+// persistent and coherent: a push is a bump of the write offset and a
+// memcpy, and as the offset is atomic several threads may push at once.
+// Without it every push maps its own range with glMapBufferRange
+// (unsynchronized, the fences already protect it) and unmaps it again, so
+// pushes must stay on the GL thread.
+//
+// A frame that runs out of space drops the rest of its pushes and the next
+// beginFrame() doubles the buffer.
+class UniformRing {
+public:
+  static const int FRAMES = 3;
+
+  // binding points, see bindBlocks()
+  enum Binding : GLuint { FRAME = 0, DRAW = 1, BONES = 2 };
+
+  // the Bones block of the skinning shaders is a fixed mat4[MAX_BONES]
+  static const int MAX_BONES = 100;
+
+  struct Range {
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+    bool valid() const { return size > 0; }
+  };
+
+  struct Stats {
+    size_t bytes = 0;    // pushed, alignment included
+    size_t capacity = 0; // of one frame's region
+    int pushes = 0;
+    int binds = 0;
+    int waits = 0; // beginFrame() calls that found the GPU still reading
+    bool persistent = false;
+  };
+
+  explicit UniformRing(size_t frameBytes = 1 << 20)
+      : regionSize(frameBytes) {}
+
+  // points the Frame, Draw and Bones blocks of `shader` (those it has) at
+  // the binding points the ring binds to
+  static void bindBlocks(Shader &shader) {
+    shader.bindBlock("Frame", FRAME);
+    shader.bindBlock("Draw", DRAW);
+    shader.bindBlock("Bones", BONES);
+  }
+
+  // call once per frame before the first push; needs the GL context
+  void beginFrame() {
+    lastFrameStats = stats;
+    lastFrameStats.bytes = std::min(head.load(), regionSize);
+    lastFrameStats.pushes = pushes.load();
+    if (buffer == 0 || overflowed)
+      create(overflowed ? regionSize * 2 : regionSize);
+    stats = Stats();
+    stats.capacity = regionSize;
+    stats.persistent = mapped != nullptr;
+
+    frame++;
+    int region = (int)(frame % FRAMES);
+    if (fences[region]) {
+      GLenum result = glClientWaitSync(fences[region],
+                                       GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+      if (result == GL_TIMEOUT_EXPIRED) {
+        stats.waits++;
+        while (result == GL_TIMEOUT_EXPIRED)
+          result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT,
+                                    1000000); // 1 ms
+      }
+      glDeleteSync(fences[region]);
+      fences[region] = nullptr;
+    }
+    base = (size_t)region * regionSize;
+    head = 0;
+    pushes = 0;
+  }
+
+  // call after the frame's last draw
+  void endFrame() {
+    int region = (int)(frame % FRAMES);
+    if (buffer != 0 && !fences[region])
+      fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  // Copies `size` bytes into the current frame's region. `reserve` (at least
+  // `size`) is the size of the returned range, for blocks that are declared
+  // larger than the part actually used. Returns an invalid range once the
+  // region is full.
+  Range push(const void *data, size_t size, size_t reserve = 0) {
+    reserve = std::max(reserve, size);
+    size_t aligned = (reserve + alignment - 1) / alignment * alignment;
+    size_t offset = head.fetch_add(aligned);
+    if (offset + reserve > regionSize) {
+      if (!overflowed.exchange(true))
+        std::cout << "ERROR::UNIFORM_RING:: frame needs more than "
+                  << regionSize << " bytes, growing next frame" << std::endl;
+      return Range();
+    }
+    offset += base;
+    if (mapped) {
+      std::memcpy(mapped + offset, data, size);
+    } else {
+      GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+      void *target = glMapBufferRange(
+          GL_UNIFORM_BUFFER, (GLintptr)offset, (GLsizeiptr)size,
+          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+              GL_MAP_UNSYNCHRONIZED_BIT);
+      if (target) {
+        std::memcpy(target, data, size);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+      }
+    }
+    pushes++;
+    return Range{(GLintptr)offset, (GLsizeiptr)reserve};
+  }
+
+  template <typename T> Range push(const T &block) {
+    return push(&block, sizeof(T));
+  }
+
+  // `count` matrices of a Bones block
+  Range pushBones(const glm::mat4 *bones, int count) {
+    count = std::clamp(count, 0, MAX_BONES);
+    return push(bones, count * sizeof(glm::mat4),
+                MAX_BONES * sizeof(glm::mat4));
+  }
+
+  void bind(Binding binding, const Range &range) {
+    if (!range.valid())
+      return;
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, range.offset,
+                      range.size);
+    // also replaces the generic binding
+    GLState::cache().uniformBuffer = buffer;
+    stats.binds++;
+  }
+
+  // the same range as a shader storage block (GL 4.3), for per-draw arrays
+  // indexed in the shader
+  void bindStorage(GLuint binding, const Range &range) {
+    if (!range.valid())
+      return;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer, range.offset,
+                      range.size);
+    GLState::cache().shaderStorageBuffer = buffer;
+    stats.binds++;
+  }
+
+  // for sources other than uniform blocks, e.g. GL_DRAW_INDIRECT_BUFFER
+  GLuint id() const { return buffer; }
+
+  const Stats &lastFrame() const { return lastFrameStats; }
+
+private:
+  GLuint buffer = 0;
+  unsigned char *mapped = nullptr; // persistent mapping, null in the fallback
+  size_t regionSize;
+  size_t alignment = 256;
+  size_t base = 0; // start of the current frame's region
+  std::atomic<size_t> head{0};
+  std::atomic<int> pushes{0};
+  GLsync fences[FRAMES] = {};
+  unsigned long long frame = 0;
+  std::atomic<bool> overflowed{false};
+  Stats stats, lastFrameStats;
+
+  void create(size_t size) {
+    if (buffer != 0) {
+      // nothing may still read the old buffer
+      glFinish();
+      for (GLsync &fence : fences) {
+        if (fence)
+          glDeleteSync(fence);
+        fence = nullptr;
+      }
+      if (mapped) {
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+      }
+      GLState::deleteBuffer(buffer);
+      mapped = nullptr;
+    }
+    GLint align = 0, storageAlign = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    if (GLAD_GL_VERSION_4_3)
+      glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlign);
+    alignment = (size_t)std::max({align, storageAlign, 1});
+    regionSize = (size + alignment - 1) / alignment * alignment;
+    overflowed = false;
+
+    glGenBuffers(1, &buffer);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    GLsizeiptr total = (GLsizeiptr)(regionSize * FRAMES);
+    if (GLAD_GL_VERSION_4_4) {
+      GLbitfield flags =
+          GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_UNIFORM_BUFFER, total, nullptr, flags);
+      mapped = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, total,
+                                                 flags);
+    } else {
+      glBufferData(GL_UNIFORM_BUFFER, total, nullptr, GL_STREAM_DRAW);
+    }
+  }
+};
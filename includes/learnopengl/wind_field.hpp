@@ -0,0 +1,93 @@
+#pragma once
+#include "learnopengl/gl_state.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <vector>
+
+// World-space wind over a rectangle of the XZ plane, in two textures:
+//   texture  R16F, resolution x resolution: local wind strength in [0.5, 1],
+//            written once by the constructor
+//   gust     R16F, resolution x 1: slow sway offset at the top of a blade,
+//            refreshed once per frame by update(); it only varies along x
+// The sway at a point is gust * strength. Anything animated by wind (grass
+// now, cloth or particles later) samples both with uv = (xz - origin) / size,
+// the gust row at (uv.x, 0.5).
+class WindField {
+public:
+  glm::vec2 origin;
+  glm::vec2 size;
+  int resolution;
+  GLuint texture = 0;
+  GLuint gust = 0;
+
+  WindField(glm::vec2 origin, glm::vec2 size, int resolution)
+      : origin(origin), size(size), resolution(resolution),
+        columnX(resolution), gustRow(resolution) {
+    // the strength only depends on position, so the noise runs once here
+    std::vector<float> strength(resolution * resolution);
+    for (int z = 0; z < resolution; z++)
+      for (int x = 0; x < resolution; x++)
+        strength[z * resolution + x] =
+            0.5f + noise(worldPos(x, z) * 0.1f) * 0.5f;
+    for (int x = 0; x < resolution; x++)
+      columnX[x] = worldPos(x, 0).x;
+
+    texture = createTexture(resolution, resolution, strength.data());
+    gust = createTexture(resolution, 1, nullptr);
+  }
+
+  // one cosine per column, uploaded as a single row
+  void update(float time) {
+    for (int x = 0; x < resolution; x++)
+      gustRow[x] = std::cos(time * 0.5f + columnX[x] * 0.1f) * 0.8f;
+    GLState::bindTexture(GL_TEXTURE_2D, gust);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution, 1, GL_RED, GL_FLOAT,
+                    gustRow.data());
+  }
+
+private:
+  std::vector<float> columnX;
+  std::vector<float> gustRow;
+
+  static GLuint createTexture(int width, int height, const float *texels) {
+    GLuint id;
+    glGenTextures(1, &id);
+    GLState::bindTexture(GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED,
+                 GL_FLOAT, texels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return id;
+  }
+
+  // centre of texel (x, z)
+  glm::vec2 worldPos(int x, int z) const {
+    return origin + (glm::vec2(x, z) + 0.5f) * size / (float)resolution;
+  }
+
+  // value noise as grass.vert used to compute it per vertex
+  static float fract(float v) { return v - std::floor(v); }
+
+  static float hash22(glm::vec2 p) {
+    glm::vec3 p3 = glm::vec3(fract(p.x * 0.1031f), fract(p.y * 0.1031f),
+                             fract(p.x * 0.1031f));
+    p3 += glm::dot(p3, glm::vec3(p3.y, p3.z, p3.x) + 33.33f);
+    return fract((p3.x + p3.y) * p3.z);
+  }
+
+  static float noise(glm::vec2 p) {
+    glm::vec2 ip = glm::floor(p);
+    glm::vec2 fp = p - ip;
+    float c00 = hash22(ip);
+    float c10 = hash22(ip + glm::vec2(1.0f, 0.0f));
+    float c01 = hash22(ip + glm::vec2(0.0f, 1.0f));
+    float c11 = hash22(ip + glm::vec2(1.0f, 1.0f));
+    glm::vec2 u = fp * fp * (3.0f - 2.0f * fp);
+    float a = glm::mix(c00, c10, u.x);
+    float b = glm::mix(c01, c11, u.x);
+    return glm::mix(a, b, u.y);
+  }
+};
@@ -3,11 +3,17 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
-uniform mat4 model; // Set this to identity matrix or use it for minor shifts
-uniform mat4 view;
-uniform mat4 projection;
-uniform float scaleFactor; // e.g., 1000.0 or 10000.0
-uniform float tileFactor;  // e.g., 100.0 or 500.0
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPos;
+    float time;
+};
+layout(std140) uniform Draw {
+    mat4 model; // Set this to identity matrix or use it for minor shifts
+    float scaleFactor; // e.g., 1000.0 or 10000.0
+    float tileFactor;  // e.g., 100.0 or 500.0
+};
 
 out vec2 TexCoords;
 
@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 UV;
+in vec4 Color;
+
+// the font atlas or an image ImGui::Image() shows
+uniform sampler2D Texture;
+
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = Color * texture(Texture, UV);
+}
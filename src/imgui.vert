@@ -0,0 +1,21 @@
+#version 330 core
+// ImGui's triangles as ImGuiRenderer replays them, in display coordinates.
+
+layout(location = 0) in vec2 pos;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec4 color;
+
+// display to clip space, ImGuiRenderer::DrawBlock
+layout(std140) uniform Draw {
+    mat4 projection;
+};
+
+out vec2 UV;
+out vec4 Color;
+
+void main()
+{
+    gl_Position = projection * vec4(pos, 0.0, 1.0);
+    UV = uv;
+    Color = color;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+// Lines and quads batched by ImmediateRenderer, in world space or pixels.
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec4 color;
+
+// clip transform of the layer, ImmediateRenderer::DrawBlock
+layout(std140) uniform Draw {
+    mat4 transform;
+};
+
+out vec4 Color;
+
+void main()
+{
+    gl_Position = transform * vec4(pos, 1.0);
+    Color = color;
+}
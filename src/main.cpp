@@ -9,20 +9,33 @@
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
-#include <imgui_impl_opengl3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/camera.h>
+#include <learnopengl/cpu_profiler.hpp>
+#include <learnopengl/dynamic_resolution.hpp>
 #include <learnopengl/filesystem.h>
 #include <learnopengl/grass_field.hpp>
+#include <learnopengl/gpu_profiler.hpp>
+#include <learnopengl/hiz.hpp>
+#include <learnopengl/imgui_renderer.hpp>
+#include <learnopengl/immediate_renderer.hpp>
+#include <learnopengl/instanced_model.hpp>
+#include <learnopengl/mesh_pool.hpp>
 #include <learnopengl/model.h>
 #include <learnopengl/model_animation_abstraction.h>
+#include <learnopengl/render_graph.hpp>
+#include <learnopengl/render_thread.hpp>
 #include <learnopengl/shader_m.h>
+#include <learnopengl/shader_variants.hpp>
+#include <learnopengl/texture_streamer.hpp>
+#include <learnopengl/uniform_ring.hpp>
 
 #include <learnopengl/animator.h>
+#include <learnopengl/benchmark.hpp>
 
 #include <chrono>
 #include <cstdlib>
@@ -31,13 +44,13 @@
 #include <memory>
 #include <optional>
 #include <random>
+#include <utility>
 
 #define MINIAUDIO_IMPLEMENTATION
 #include <miniaudio.h>
 
 #include "../includes/learnopengl/cubemap.hpp"
 
-void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window, float deltaTime);
@@ -65,6 +78,8 @@ float lastFrame = 0.0f;
 
 std::optional<ModelAnimationAbs> knight;
 std::optional<ModelAnimationAbs> hornet;
+// set when running headless with --benchmark
+std::optional<Benchmark> benchmark;
 
 inline bool CheckAABBCollision(const glm::vec3 &posA, const glm::vec3 &sizeA,
                                const glm::vec3 &posB, const glm::vec3 &sizeB) {
@@ -113,6 +128,12 @@ std::uniform_real_distribution<float> toOneDist(0.0f, 1.0f);
 std::uniform_real_distribution<float> toTenDist(0.0f, 10.f);
 
 std::unique_ptr<HealthBar> playerHealth;
+std::vector<ModelAnimationAbs> horde;
+std::vector<ModelAnimationAbs> props;
+// render-side state, only touched by the render thread (see FrameCommands)
+RenderQueue renderQueue;
+GpuProfiler gpuProfiler;
+UniformRing uniformRing;
 
 GLFWwindow *window;
 
@@ -123,6 +144,66 @@ ImFont *font100;
 
 float game_over_time = 0;
 
+// F3 toggles the frame statistics overlay, F4 the hitboxes, F5 writes the GPU
+// timings of the last few seconds to GPU_PROFILE_CSV and F6 the CPU zones to
+// CPU_TRACE_JSON
+bool showStats = false;
+bool showHitboxes = false;
+bool writeGpuProfile = false; // F5, for the render thread's next frame
+const char *GPU_PROFILE_CSV = "gpu_profile.csv";
+const char *CPU_TRACE_JSON = "cpu_trace.json";
+
+// what the F3 overlays show, copied out by the render thread after a frame
+struct FrameStats {
+  GrassField::Stats grass;
+  HiZ::Stats hiz;
+  InstancedModel::Stats hornets;
+  RenderQueue::Stats queue;
+  ImmediateRenderer::Stats immediate;
+  Culling::Stats cull;
+  GLState::Stats gl;
+  UniformRing::Stats ring;
+  RenderGraph::Stats graph;
+  std::vector<RenderGraph::PassStats> passes;
+  size_t shaderVariants = 0;
+  float resolutionScale = 1.0f;
+  float gpuMs = 0.0f;
+  float budgetMs = 0.0f;
+  std::vector<GpuProfiler::Summary> gpu;
+  uint64_t gpuDropped = 0;
+  TextureStreamer::Stats streaming;
+  std::vector<TextureStreamer::Info> textures;
+};
+
+// One frame as the main thread records it and the render thread replays it
+// (RenderThread keeps three of these). Everything the replay reads is a copy
+// of simulation state; the vectors keep their capacity across frames.
+struct FrameCommands {
+  bool playing = false; // otherwise a menu: only the ImGui windows
+  float time = 0.0f;
+  int fbWidth = 0, fbHeight = 0;
+  Camera camera;
+  // actors[0, actorCount) go through the RenderQueue, the instanced ones
+  // through the hornets' InstancedModel
+  std::vector<RecordedActor> actors, instanced;
+  size_t actorCount = 0, instancedCount = 0;
+  ImmediateRenderer immediate; // HUD, and hitboxes while showHitboxes
+  bool showHitboxes = false;
+  bool collectStats = false;
+  bool writeGpuProfile = false;
+  ImGuiRenderer::Frame imgui; // copied from the context, see ImGuiRenderer
+  FrameStats stats; // written by the render thread when collectStats
+
+  void addActor(ModelAnimationAbs &actor, bool instance) {
+    std::vector<RecordedActor> &list = instance ? instanced : actors;
+    size_t &count = instance ? instancedCount : actorCount;
+    if (count == list.size())
+      list.emplace_back();
+    if (actor.record(list[count], lastFrame))
+      count++;
+  }
+};
+
 void randomHornetState() {
   if (hornetState == HornetState::DEAD) {
     return;
@@ -215,6 +296,7 @@ void randomHornetState() {
 }
 
 void updateHornetState() {
+  PROFILE_ZONE("updateHornetState");
   switch (hornetState) {
   case HornetState::LUNGE_WAIT: {
     if (lastFrame > lastHornetStateSet + 0.5f) {
@@ -304,7 +386,9 @@ void updateKnightState() {
 void new_sound(std::unique_ptr<ma_sound> &sound, std::string file,
                float volume) {
   ;
-  auto ma_result = ma_sound_init_from_file(&audioEngine, file.c_str(), 0, NULL,
+  // prefer the PCM copy from hk_bake, skips mp3 decoding at load time
+  std::string path = BakedAssets::resolveAudio(file);
+  auto ma_result = ma_sound_init_from_file(&audioEngine, path.c_str(), 0, NULL,
                                            NULL, sound.get());
   assert(ma_result == MA_SUCCESS);
   ma_sound_set_volume(sound.get(), volume);
@@ -406,7 +490,225 @@ void RenderLoseWin(bool hasWon) {
   ImGui::End();
 }
 
+// culling and state counters of the last rendered frame, top-left corner
+void RenderStats(const FrameStats &stats,
+                 const RenderThread<FrameCommands> &renderThread) {
+  const ImGuiViewport *viewport = ImGui::GetMainViewport();
+  ImGui::SetNextWindowPos(
+      ImVec2(viewport->WorkPos.x + 10.0f, viewport->WorkPos.y + 10.0f));
+  ImGui::SetNextWindowBgAlpha(0.5f);
+  ImGuiWindowFlags window_flags =
+      ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+      ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+      ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs;
+  ImGui::Begin("Stats", nullptr, window_flags);
+
+  const Culling::Stats &cull = stats.cull;
+  const GLState::Stats &gl = stats.gl;
+  const GrassField::Stats &grass = stats.grass;
+  const HiZ::Stats &hiz = stats.hiz;
+  const InstancedModel::Stats &hornets = stats.hornets;
+  ImGui::Text("%.1f fps (%.2f ms)", imguiIO->Framerate,
+              1000.0f / imguiIO->Framerate);
+  if (renderThread.threaded()) {
+    const RenderThread<FrameCommands>::Stats &thread =
+        renderThread.frameStats();
+    ImGui::Text("render thread: main waited %.2f ms, render waited %.2f ms",
+                thread.recordWaitMs, thread.renderWaitMs);
+  }
+  ImGui::Text("resolution: %.0f%% (gpu %.2f ms, budget %.1f ms)",
+              stats.resolutionScale * 100.0f, stats.gpuMs, stats.budgetMs);
+  ImGui::Text("models: %u / %u", cull.display, cull.total);
+  ImGui::Text("meshes: %u / %u", cull.meshDisplay, cull.meshTotal);
+  ImGui::Text("occluded: %u models, %u meshes, %d grass tiles", cull.occluded,
+              cull.meshOccluded, grass.tilesOccluded);
+  ImGui::Text("hi-z: %u / %u boxes culled", hiz.occluded, hiz.tested);
+  if (grass.gpuCulled)
+    ImGui::Text("grass: culled on the GPU");
+  else
+    ImGui::Text("grass tiles: %d / %d, blades: %lld", grass.tilesDrawn,
+                grass.tiles, grass.instances);
+  ImGui::Text("packets: %d, programs: %d, objects: %d, dropped: %d",
+              stats.queue.packets, stats.queue.programChanges,
+              stats.queue.objectChanges, stats.queue.dropped);
+  ImGui::Text("bone palettes: %d", stats.queue.palettes);
+  ImGui::Text("model shader variants: %zu", stats.shaderVariants);
+  ImGui::Text("indirect: %d packets in %d multi-draws",
+              stats.queue.indirectCommands, stats.queue.indirectDraws);
+  ImGui::Text("instanced: %d actors, %d instances in %d draws",
+              hornets.actors, hornets.instances, hornets.draws);
+  ImGui::Text("immediate: %d lines, %d triangles in %d draws",
+              stats.immediate.lines, stats.immediate.triangles,
+              stats.immediate.draws);
+  ImGui::Text("gl calls: %u issued, %u elided", gl.issued, gl.elided);
+  const UniformRing::Stats &ring = stats.ring;
+  ImGui::Text("uniforms: %zu / %zu KiB in %d pushes, %d waits%s",
+              ring.bytes / 1024, ring.capacity / 1024, ring.pushes, ring.waits,
+              ring.persistent ? "" : " (mapped per push)");
+  const RenderGraph::Stats &frame = stats.graph;
+  ImGui::Text("graph: %d passes (%d culled), %d textures in %d allocations",
+              frame.passes, frame.culled, frame.textures, frame.allocations);
+  for (const RenderGraph::PassStats &pass : stats.passes)
+    ImGui::Text("  %-8s cpu %.2f ms, gpu %.2f ms", pass.name.c_str(),
+                pass.cpuMs, pass.gpuMs);
+  ImGui::End();
+}
+
+// resident mips per streamed texture, largest first, bottom-right corner
+void RenderTextureStreaming(
+    const TextureStreamer::Stats &stats,
+    const std::vector<TextureStreamer::Info> &textures) {
+  if (stats.textures == 0)
+    return;
+  const ImGuiViewport *viewport = ImGui::GetMainViewport();
+  ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x -
+                                     10.0f,
+                                 viewport->WorkPos.y + viewport->WorkSize.y -
+                                     10.0f),
+                          ImGuiCond_Always, ImVec2(1.0f, 1.0f));
+  ImGui::SetNextWindowBgAlpha(0.5f);
+  ImGuiWindowFlags window_flags =
+      ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+      ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+      ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs;
+  ImGui::Begin("Textures", nullptr, window_flags);
+
+  ImGui::Text("textures: %.1f / %.1f MB, %d uploads, %d evictions, "
+              "%d pending",
+              stats.resident / 1048576.0, stats.budget / 1048576.0,
+              stats.uploads, stats.evictions, stats.pending);
+  if (ImGui::BeginTable("textures", 4)) {
+    for (const char *column : {"texture", "MB", "bias", "wanted"})
+      ImGui::TableSetupColumn(column);
+    ImGui::TableHeadersRow();
+    for (const TextureStreamer::Info &texture : textures) {
+      std::string name =
+          texture.path.substr(texture.path.find_last_of('/') + 1);
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%s %ux%u", name.c_str(), texture.width, texture.height);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.2f", texture.bytes / 1048576.0);
+      ImGui::TableNextColumn();
+      ImGui::Text("%d%s", texture.base, texture.loading ? " +" : "");
+      ImGui::TableNextColumn();
+      ImGui::Text("%d", texture.wanted);
+    }
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
+
+// GPU time per scope over the profiler history, top-right corner
+void RenderGpuProfile(const std::vector<GpuProfiler::Summary> &scopes,
+                      uint64_t dropped) {
+  const ImGuiViewport *viewport = ImGui::GetMainViewport();
+  ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x -
+                                     10.0f,
+                                 viewport->WorkPos.y + 10.0f),
+                          ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+  ImGui::SetNextWindowBgAlpha(0.5f);
+  ImGuiWindowFlags window_flags =
+      ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+      ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+      ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs;
+  ImGui::Begin("GPU", nullptr, window_flags);
+
+  ImGui::Text("gpu ms over %d frames (F5: csv)", GpuProfiler::HISTORY);
+  if (ImGui::BeginTable("scopes", 6)) {
+    for (const char *column : {"scope", "last", "avg", "p50", "p95", "p99"})
+      ImGui::TableSetupColumn(column);
+    ImGui::TableHeadersRow();
+    for (const GpuProfiler::Summary &scope : scopes) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%*s%s", scope.depth * 2, "", scope.name.c_str());
+      for (double value :
+           {scope.last, scope.average, scope.p50, scope.p95, scope.p99}) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", value);
+      }
+    }
+    ImGui::EndTable();
+  }
+  if (dropped > 0)
+    ImGui::Text("%llu frames dropped (gpu behind)",
+                (unsigned long long)dropped);
+  ImGui::End();
+}
+
+#ifdef HK_PROFILE
+// frame times of the recent CPU frames and a flame graph of the slowest one,
+// one per thread, bottom-left corner
+void RenderCpuProfile(const RenderThread<FrameCommands> &renderThread) {
+  std::vector<CpuProfiler::Frame> frames = CpuProfiler::recentFrames();
+  if (frames.empty())
+    return;
+  std::vector<float> frameMs;
+  size_t slowest = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    frameMs.push_back((frames[i].end - frames[i].start) / 1.0e6f);
+    if (frameMs[i] > frameMs[slowest])
+      slowest = i;
+  }
+  const CpuProfiler::Frame &spike = frames[slowest];
+
+  const float width = 600.0f, rowHeight = 18.0f;
+  const ImGuiViewport *viewport = ImGui::GetMainViewport();
+  ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + 10.0f,
+                                 viewport->WorkPos.y + viewport->WorkSize.y -
+                                     10.0f),
+                          ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+  ImGui::SetNextWindowBgAlpha(0.5f);
+  ImGuiWindowFlags window_flags =
+      ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+      ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+      ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs;
+  ImGui::Begin("CPU", nullptr, window_flags);
+  ImGui::Text("cpu frames, slowest %.2f ms (F6: trace)", frameMs[slowest]);
+  ImGui::PlotHistogram("##frames", frameMs.data(), (int)frameMs.size(), 0,
+                       nullptr, 0.0f, FLT_MAX, ImVec2(width, 40.0f));
+
+  // per thread, one row per nesting level, spanning the slowest frame. The
+  // render thread's zones there belong to the frame recorded before it.
+  std::vector<std::pair<const char *, uint32_t>> threads = {
+      {"main", CpuProfiler::threadId()}};
+  if (renderThread.profilerId() >= 0)
+    threads.push_back({"render", (uint32_t)renderThread.profilerId()});
+  ImDrawList *draw = ImGui::GetWindowDrawList();
+  double scale = width / (double)(spike.end - spike.start);
+  for (const auto &[threadName, thread] : threads) {
+    std::vector<CpuProfiler::Event> events =
+        CpuProfiler::eventsIn(spike, thread);
+    int rows = 1;
+    for (const CpuProfiler::Event &e : events)
+      rows = std::max(rows, e.depth + 1);
+    ImGui::Text("%s thread", threadName);
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::Dummy(ImVec2(width, rows * rowHeight));
+    for (const CpuProfiler::Event &e : events) {
+      float x0 = origin.x + (float)((e.start - spike.start) * scale);
+      float x1 = origin.x + (float)((e.end - spike.start) * scale);
+      float y0 = origin.y + e.depth * rowHeight;
+      x1 = std::max(x1, x0 + 1.0f);
+      ImU32 color = ImGui::GetColorU32(
+          ImVec4(0.9f, 0.45f + 0.1f * (e.depth % 4), 0.2f, 0.9f));
+      draw->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y0 + rowHeight - 1.0f),
+                          color);
+      char label[128];
+      snprintf(label, sizeof(label), "%s %.2f", e.name,
+               (e.end - e.start) / 1.0e6);
+      if (ImGui::CalcTextSize(label).x < x1 - x0 - 4.0f)
+        draw->AddText(ImVec2(x0 + 2.0f, y0 + 1.0f), IM_COL32_BLACK, label);
+    }
+  }
+  ImGui::End();
+}
+#endif
+
 void playerTakeDamage(uint damage) {
+  if (benchmark)
+    return; // the scripted scene must not end
   currentHealth -= damage;
   if (currentHealth == 0) {
     menu_state = MenuType::LOSE;
@@ -415,9 +717,74 @@ void playerTakeDamage(uint damage) {
   playerHealth->setHealth(currentHealth, maxHealth);
 }
 
-int main() {
+// knockback and damage between the knight, its nail and the hornet
+void checkCollisions() {
+  PROFILE_ZONE("checkCollisions");
+  // Check if knight body hit hornet
+  if (hornetState != HornetState::DEAD &&
+      lastFrame > DAMAGE_COOLDOWN + knight->lastHit &&
+      CheckAABBCollision(knight->position, knight->modelSize,
+                         hornet->position, hornet->modelSize)) {
+    // knight->position +=
+    //     glm::normalize(knight->position - hornet->position) * 1.0f;
+    knight->velocity +=
+        glm::normalize(knight->position - hornet->position) * KNOCKBACK_SPEED;
+    playerTakeDamage(1);
+    knight->lastHit = lastFrame;
+  }
+
+  // Check if knight's nail hit hornet
+  if (hornetState != HornetState::DEAD &&
+      knightState == KnightState::ATTACKING &&
+      lastFrame > DAMAGE_COOLDOWN + hornet->lastHit &&
+      CheckAABBCollision(knight->getWeaponPosition(), knight->model->weaponSize,
+                         hornet->position, hornet->modelSize)) {
+    // std::cout << "HIT " << lastFrame << std::endl;
+    // hornet->position +=
+    //     glm::normalize(hornet->position - knight->position) * 1.0f;
+    hornet->velocity +=
+        glm::normalize(hornet->position - knight->position) * KNOCKBACK_SPEED;
+
+    hornet->lastHit = lastFrame;
+    hornet->health -= 1;
+    if (hornet->health == 0) {
+      game_over_time = static_cast<float>(glfwGetTime());
+      menu_state = MenuType::WIN;
+    }
+    if (hornet->health == 0) {
+      hornetState = HornetState::DEAD;
+    }
+  }
+
+  // Check if hornet's needle hit knight
+  if (hornetState != HornetState::DEAD &&
+      lastFrame > DAMAGE_COOLDOWN + knight->lastHit &&
+      CheckAABBCollision(knight->position, knight->modelSize,
+                         hornet->getWeaponPosition(),
+                         hornet->model->weaponSize)) {
+    // knight->position +=
+    //     glm::normalize(hornet->position - knight->position) * 1.0f;
+    knight->velocity +=
+        glm::normalize(knight->position - hornet->position) * KNOCKBACK_SPEED;
+    playerTakeDamage(1);
+    knight->lastHit = lastFrame;
+  }
+}
+
+int main(int argc, char **argv) {
+  Benchmark::Options benchmarkOptions;
+  if (!Benchmark::parse(argc, argv, benchmarkOptions))
+    return 1;
+  if (benchmarkOptions.enabled)
+    benchmark.emplace(benchmarkOptions);
+
   // glfw: initialize and configure
   // ------------------------------
+#ifdef GLFW_PLATFORM_NULL
+  // no display connection needed at all (GLFW 3.4)
+  if (benchmark)
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
   glfwInit();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -429,11 +796,23 @@ int main() {
 
   // glfw window creation
   // --------------------
-  const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-  SCR_WIDTH = mode->width;
-  SCR_HEIGHT = mode->height;
-  window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL",
-                            glfwGetPrimaryMonitor(), NULL);
+  if (benchmark) {
+    // offscreen context; the frame goes to the benchmark's own target
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API,
+                   benchmarkOptions.osmesa ? GLFW_OSMESA_CONTEXT_API
+                                           : GLFW_EGL_CONTEXT_API);
+    SCR_WIDTH = benchmarkOptions.width;
+    SCR_HEIGHT = benchmarkOptions.height;
+    window =
+        glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+  } else {
+    const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    SCR_WIDTH = mode->width;
+    SCR_HEIGHT = mode->height;
+    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL",
+                              glfwGetPrimaryMonitor(), NULL);
+  }
   if (window == NULL) {
     const char *description;
     int code = glfwGetError(&description);
@@ -446,7 +825,6 @@ int main() {
     return -1;
   }
   glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
   glfwSetCursorPosCallback(window, mouse_callback);
   glfwSetScrollCallback(window, scroll_callback);
 
@@ -462,24 +840,30 @@ int main() {
 
   // configure global opengl state
   // -----------------------------
-  glEnable(GL_DEPTH_TEST);
-  glDisable(GL_CULL_FACE);
+  GLState::enable(GLState::DEPTH_TEST);
+  GLState::disable(GLState::CULL_FACE);
 
   unsigned seed =
       std::chrono::high_resolution_clock::now().time_since_epoch().count();
+  if (benchmark)
+    seed = Benchmark::SEED;
   randomEngine = std::default_random_engine(seed);
 
   // Audio
   // ----------------------
-  ma_result result = ma_engine_init(NULL, &audioEngine);
-  assert(result == MA_SUCCESS);
-
-  std::map<std::string, float> soundToVolume = {
-      {AUDIO_SHAW, 0.2f}, {AUDIO_EDINO, 0.2f}, {AUDIO_HAA, 0.2f}};
-  for (auto [file, volume] : soundToVolume) {
-    std::unique_ptr<ma_sound> pSound = std::make_unique<ma_sound>();
-    new_sound(pSound, file, volume);
-    preLoadedSounds[file] = std::move(pSound);
+  // benchmark machines may have no audio device; ma_sound_start ignores the
+  // missing sounds
+  if (!benchmark) {
+    ma_result result = ma_engine_init(NULL, &audioEngine);
+    assert(result == MA_SUCCESS);
+
+    std::map<std::string, float> soundToVolume = {
+        {AUDIO_SHAW, 0.2f}, {AUDIO_EDINO, 0.2f}, {AUDIO_HAA, 0.2f}};
+    for (auto [file, volume] : soundToVolume) {
+      std::unique_ptr<ma_sound> pSound = std::make_unique<ma_sound>();
+      new_sound(pSound, file, volume);
+      preLoadedSounds[file] = std::move(pSound);
+    }
   }
 
   // GUI
@@ -494,29 +878,46 @@ int main() {
       "resources/fonts/ComicSansMS3.ttf", 100.0f);
   ImGui_ImplGlfw_InitForOpenGL(window,
                                true); // 'true' sets up callbacks for input
-  ImGui_ImplOpenGL3_Init("#version 330");
+  // builds the font atlas ImGui::NewFrame() needs while this thread still has
+  // the GL context; the render thread only draws recorded frames
+  ImGuiRenderer imguiRenderer;
+  imguiRenderer.init();
 
   // build and compile shaders
   // -------------------------
-  Shader skyboxShader("src/texturedModel.vert", "src/skybox.frag");
+  Shader skyboxShader("src/skybox.vert", "src/skybox.frag");
 
-  Shader texturedModelWithBonesShader("src/texturedModelWithBones.vert",
-                                      "src/texturedModelWithBones.frag");
+  // every model draw: one variant per combination of ShaderFeature bits
+  ShaderVariants modelShaders("src/texturedModel.vert",
+                              "src/texturedModel.frag",
+                              UniformRing::bindBlocks);
 
-  Shader simple3dShader("src/simple3d.vert", "src/simple3d.frag");
+  Shader immediateShader("src/immediate.vert", "src/immediate.frag");
 
-  Shader simple2dShader("src/simple2d.vert", "src/simple3d.frag");
+  Shader imguiShader("src/imgui.vert", "src/imgui.frag");
 
   Shader groundShader("src/ground.vert", "src/ground.frag");
 
   Shader grassFieldShader("src/grass.vert", "src/grass.frag");
 
+  // per-frame and per-draw constants live in uniformRing
+  for (Shader *shader :
+       {&skyboxShader, &immediateShader, &imguiShader, &groundShader,
+        &grassFieldShader})
+    UniformRing::bindBlocks(*shader);
+
   GroundPlane ground("resources/grass_ground.png", 10000.0, 500.0);
 
   GrassField grass = GrassField(1000, 1000, 0.6);
+  glm::vec2 grassExtent = glm::vec2(grass.gridX, grass.gridZ) * grass.spacing;
+  WindField wind(-grassExtent * 0.5f, grassExtent, 256);
+  // compute + indirect path on GL 4.3, tiled instancing otherwise
+  grass.enableGpuCulling("src/grass_cull.comp");
 
   // load models
   // -----------
+  TextureStreamer::instance().enabled = STREAM_TEXTURES;
+  TextureStreamer::instance().budget = (size_t)TEXTURE_BUDGET_MB << 20;
   // tell stb_image.h to flip loaded texture's on the y-axis (before loading
   // model).
   stbi_set_flip_vertically_on_load(false);
@@ -545,16 +946,71 @@ int main() {
   hornet->model->weaponHitbox->scale = 0.7;
   hornet->model->weaponSize *= 0.7;
 
+  // the boss and the horde share one model and draw in one call per mesh
+  InstancedModel hornets(hornet->model, modelShaders);
+  bool instancedHornets = hornets.enable();
+  horde.reserve(HORDE_SIZE);
+  for (int i = 0; i < HORDE_SIZE; i++) {
+    // rings of 100 around the arena, facing the middle
+    float angle = glm::two_pi<float>() * (float)(i % 100) / 100.0f;
+    float radius = 25.0f + 3.0f * (float)(i / 100);
+    glm::vec3 position(std::cos(angle) * radius, 0.0f,
+                       std::sin(angle) * radius);
+    glm::mat4 lookAtMatrix =
+        glm::lookAt(position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    horde.emplace_back(*hornet, position,
+                       glm::quat_cast(glm::mat3(glm::transpose(lookAtMatrix))));
+    ModelAnimationAbs &member = horde.back();
+    member.setAnimation("lunge", AnimationRunType::FORWARD_AND_BACKWARD, false);
+    member.animator.m_CurrentTime =
+        toOneDist(randomEngine) * member.animator.duration;
+  }
+
+  // static props live in one shared buffer and, with GL 4.3, are merged into
+  // multi-draw indirect calls; otherwise they are drawn one by one like the
+  // characters (their vertices have no weights, so they stay in bind pose)
+  MeshPool meshPool;
+  bool indirectProps = renderQueue.enableIndirect(meshPool);
+  Assimp::Importer propImporter;
+  if (PROP_COUNT > 0) {
+    props.reserve(PROP_COUNT);
+    props.emplace_back(propImporter, "resources/stone_ground_01_a.glb",
+                       "stoneGround", "");
+    for (Mesh &mesh : props.front().model->meshes)
+      meshPool.add(mesh);
+    for (int i = 1; i < PROP_COUNT; i++) {
+      float angle = glm::two_pi<float>() * toOneDist(randomEngine);
+      float radius = 10.0f + 50.0f * toOneDist(randomEngine);
+      glm::vec3 position(std::cos(angle) * radius, 0.0f,
+                         std::sin(angle) * radius);
+      props.emplace_back(props.front(), position,
+                         glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    // they never move, one update places them for good
+    for (ModelAnimationAbs &prop : props)
+      prop.update(glm::mat4(1.0f), 0.0f);
+  }
+
+  // compile the variants the models will ask for now instead of on the
+  // frame that first needs each one; skinned meshes need one per skin group
+  auto precompile = [&](const Model &model, uint32_t features) {
+    for (const Mesh &mesh : model.meshes)
+      for (const Mesh::SkinGroup &group : mesh.skinGroups)
+        modelShaders.precompile(features | mesh.shaderFeatures() |
+                                group.features);
+  };
+  precompile(*knight->model, 0);
+  precompile(*knight->model, ShaderFeature::HIT_FLASH);
+  precompile(*hornet->model, instancedHornets ? ShaderFeature::INSTANCED : 0u);
+  precompile(*hornet->model, ShaderFeature::HIT_FLASH);
+  if (!props.empty())
+    precompile(*props.front().model,
+               indirectProps ? ShaderFeature::INDIRECT : 0u);
+
   Cubemap sky = Cubemap({"resources/sky/right.png", "resources/sky/left.png",
                          "resources/sky/top.png", "resources/sky/bottom.png",
                          "resources/sky/front.png", "resources/sky/back.png"});
 
-  // Assimp::Importer stoneGroundImporter;
-  // ModelAnimationAbs stoneGround(stoneGroundImporter,
-  //                               "resources/stone_ground_01_a.glb",
-  //                               "stoneGround", "");
-  // // stoneGround.position.y = 4.0f;
-
   // tell GLFW to capture our mouse
   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -563,34 +1019,264 @@ int main() {
   // draw in wireframe
   // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-  // render loop
-  // -----------
+  // the 3D scene renders into graph-owned targets so its depth can feed the
+  // Hi-Z pyramid
+  RenderGraph frameGraph;
+  frameGraph.profile(&gpuProfiler);
+  HiZ hiz;
+  hiz.enable("src/hiz_reduce.comp");
+  // the 3D scene renders at a scale of the screen that keeps the GPU within
+  // budget; the HUD and ImGui stay native. Benchmarks keep a fixed size.
+  DynamicResolution resolution(FRAME_BUDGET_MS, MIN_RESOLUTION_SCALE);
+  resolution.enabled = !benchmark;
+
+  if (benchmark) {
+    benchmark->createTarget();
+    menu_state = MenuType::PLAYING;
+    onStartGame();
+  }
+
+  // Replays one recorded frame; runs on the render thread, which owns the GL
+  // context from here on. It reads the frame's copies of the simulation
+  // state (the local `camera` hides the global one) and the render-side
+  // objects above, which nothing else touches any more.
+  auto renderFrame = [&](FrameCommands &frame) {
+    gpuProfiler.beginFrame();
+    uniformRing.beginFrame();
+
+    if (!frame.playing) {
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    } else {
+      Camera &camera = frame.camera;
+      int fbWidth = frame.fbWidth, fbHeight = frame.fbHeight;
+      resolution.update(gpuProfiler.frameMs());
+      int sceneWidth = resolution.scaled(fbWidth);
+      int sceneHeight = resolution.scaled(fbHeight);
+
+      // view/projection transformations
+      glm::mat4 projection =
+          glm::perspective(glm::radians(camera.Zoom),
+                           (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+      glm::mat4 view = camera.GetViewMatrix();
+
+      Frustum frustum = createFrustumFromCamera(
+          camera, (float)SCR_WIDTH / (float)SCR_HEIGHT,
+          glm::radians(camera.Zoom), 0.1f, 100.0f);
+      hiz.beginFrame();
+      wind.update(frame.time);
+      uniformRing.bind(UniformRing::FRAME,
+                       uniformRing.push(FrameBlock{view, projection,
+                                                   camera.Position,
+                                                   frame.time}));
+
+      // cull and queue the models before any pass runs
+      TextureStreamer::instance().beginFrame(
+          camera.Position,
+          sceneHeight / (2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f)));
+      renderQueue.begin(uniformRing, view, 100.0f);
+      hornets.begin();
+      for (size_t i = 0; i < frame.actorCount; i++)
+        frame.actors[i].submit(renderQueue, modelShaders, frustum, &hiz);
+      for (size_t i = 0; i < frame.instancedCount; i++)
+        frame.instanced[i].submit(hornets, frustum, &hiz);
+      // mips for what was just queued arrive over the next frames
+      TextureStreamer::instance().update();
+
+      RenderGraph::TextureDesc screenDesc{fbWidth, fbHeight, GL_RGBA8};
+      RenderGraph::TextureDesc colorDesc{sceneWidth, sceneHeight, GL_RGBA8};
+      RenderGraph::TextureDesc depthDesc{sceneWidth, sceneHeight,
+                                         GL_DEPTH_COMPONENT32F};
+      RenderGraph::Resource backbuffer =
+          frameGraph.import("backbuffer", benchmark ? benchmark->target() : 0,
+                            screenDesc);
+      RenderGraph::Resource sceneColor, sceneDepth;
+
+      // opaque geometry roughly front to back: characters, grass, ground
+      frameGraph.addPass(
+          "opaque",
+          [&](RenderGraph::Builder &b) {
+            sceneColor = b.create("scene color", colorDesc);
+            sceneDepth = b.create("scene depth", depthDesc);
+          },
+          [&](const RenderGraph::Context &) {
+            glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+            GLState::depthMask(true);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            GLState::enable(GLState::DEPTH_TEST);
+            {
+              GpuProfiler::Scope scope(gpuProfiler, "characters");
+              renderQueue.flush(uniformRing);
+              hornets.flush(uniformRing);
+            }
+            {
+              GpuProfiler::Scope scope(gpuProfiler, "grass");
+              grass.draw(grassFieldShader, uniformRing, frustum,
+                         camera.Position, wind, &hiz);
+            }
+            GpuProfiler::Scope scope(gpuProfiler, "ground");
+            ground.Draw(groundShader, uniformRing);
+          });
+
+      // the sky sits at the far plane, so it only shades uncovered pixels
+      frameGraph.addPass(
+          "sky",
+          [&](RenderGraph::Builder &b) {
+            b.read(sceneColor);
+            b.write(sceneColor);
+            b.read(sceneDepth);
+            b.write(sceneDepth); // attached for the test, writes are masked
+          },
+          [&](const RenderGraph::Context &) {
+            GLState::depthMask(false);
+            sky.draw(skyboxShader);
+            GLState::depthMask(true);
+          });
+
+      // debug lines over the finished scene, only while F4 shows them
+      if (frame.showHitboxes)
+        frameGraph.addPass(
+            "debug",
+            [&](RenderGraph::Builder &b) {
+              b.read(sceneColor);
+              b.write(sceneColor);
+              b.read(sceneDepth);
+              b.write(sceneDepth); // attached for the test, not written
+            },
+            [&](const RenderGraph::Context &) {
+              glm::mat4 viewProjection = projection * view;
+              frame.immediate.flush(ImmediateRenderer::WORLD,
+                                    immediateShader, uniformRing,
+                                    viewProjection);
+              frame.immediate.flush(ImmediateRenderer::WORLD_ON_TOP,
+                                    immediateShader, uniformRing,
+                                    viewProjection);
+              GLState::enable(GLState::DEPTH_TEST);
+            });
+
+      frameGraph.addPass(
+          "hi-z",
+          [&](RenderGraph::Builder &b) {
+            b.read(sceneDepth);
+            b.sideEffect(); // the pyramid lives outside the graph
+          },
+          [&](const RenderGraph::Context &ctx) {
+            hiz.build(ctx.texture(sceneDepth), sceneWidth, sceneHeight,
+                      projection * view);
+          });
+
+      frameGraph.addPass(
+          "present",
+          [&](RenderGraph::Builder &b) {
+            b.read(sceneColor);
+            b.write(backbuffer);
+          },
+          [&](const RenderGraph::Context &ctx) {
+            ctx.blit(sceneColor, fbWidth, fbHeight); // upscales when scaled
+          });
+
+      frameGraph.addPass(
+          "hud",
+          [&](RenderGraph::Builder &b) {
+            b.read(backbuffer);
+            b.write(backbuffer);
+          },
+          [&](const RenderGraph::Context &) {
+            glm::mat4 uiProjection =
+                glm::ortho(0.0f, (float)SCR_WIDTH, 0.0f, (float)SCR_HEIGHT);
+            frame.immediate.flush(ImmediateRenderer::SCREEN,
+                                  immediateShader, uniformRing, uiProjection);
+            GLState::enable(GLState::DEPTH_TEST);
+          });
+
+      frameGraph.compile();
+      frameGraph.execute();
+    }
+
+    {
+      PROFILE_ZONE("ImGui");
+      if (benchmark)
+        GLState::bindFramebuffer(benchmark->framebuffer());
+      GpuProfiler::Scope scope(gpuProfiler, "imgui");
+      imguiRenderer.render(frame.imgui, imguiShader, uniformRing);
+    }
+
+    if (frame.writeGpuProfile) {
+      if (gpuProfiler.writeCsv(GPU_PROFILE_CSV))
+        std::cout << "GPU timings written to " << GPU_PROFILE_CSV << std::endl;
+      else
+        std::cout << "ERROR::GPU_PROFILER:: cannot write " << GPU_PROFILE_CSV
+                  << std::endl;
+    }
+
+    uniformRing.endFrame();
+    glfwSwapBuffers(window);
+    GLState::endFrame();
+    Culling::endFrame();
+
+    if (frame.collectStats) {
+      FrameStats &stats = frame.stats;
+      stats.grass = grass.stats;
+      stats.hiz = hiz.stats;
+      stats.hornets = hornets.stats;
+      stats.queue = renderQueue.stats;
+      stats.immediate = frame.immediate.stats;
+      stats.cull = Culling::lastFrame();
+      stats.gl = GLState::lastFrame();
+      stats.ring = uniformRing.lastFrame();
+      stats.graph = frameGraph.frame();
+      stats.passes = frameGraph.passStats();
+      stats.shaderVariants = modelShaders.compiled();
+      stats.resolutionScale = resolution.scale();
+      stats.gpuMs = resolution.smoothedGpuMs();
+      stats.budgetMs = resolution.budgetMs;
+      stats.gpu = gpuProfiler.summary();
+      stats.gpuDropped = gpuProfiler.dropped();
+      stats.streaming = TextureStreamer::instance().frameStats();
+      stats.textures = TextureStreamer::instance().textures();
+    }
+  };
+
+  // Benchmarks replay every frame on this thread right after recording it,
+  // so their frame times and captures stay comparable to older runs.
+  RenderThread<FrameCommands> renderThread(renderFrame);
+  if (RENDER_THREAD && !benchmark) {
+    glfwMakeContextCurrent(NULL);
+    renderThread.start([] { glfwMakeContextCurrent(window); },
+                       [] { glfwMakeContextCurrent(NULL); });
+  }
+
+  // simulation loop
+  // ---------------
   while (!glfwWindowShouldClose(window)) {
+    PROFILE_FRAME();
+    if (benchmark)
+      benchmark->beginFrame();
     glfwPollEvents();
 
-    ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
+    // waits while the render thread is more than a frame behind
+    FrameCommands &frame = renderThread.record();
+    frame.playing = false;
+    frame.showHitboxes = false;
+    frame.collectStats = false;
+
     if (menu_state == MenuType::START_MENU) {
       glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 
       RenderMenu();
-
-      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     } else if (menu_state == MenuType::LOSE || menu_state == MenuType::WIN) {
       glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 
       RenderLoseWin(menu_state == MenuType::WIN);
-
-      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     } else {
       glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
       // per-framema_engine *pEngine time logic
       // --------------------
-      float currentFrame = static_cast<float>(glfwGetTime());
+      float currentFrame = benchmark ? benchmark->time()
+                                     : static_cast<float>(glfwGetTime());
       deltaTime = currentFrame - lastFrame;
       lastFrame = currentFrame;
 
@@ -602,41 +1288,26 @@ int main() {
       // -----
       processInput(window, deltaTime);
 
-      // render
-      // ------
-      glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-      glEnable(GL_DEPTH_TEST);
-
+      // simulation
+      // ----------
       knight->updatePosition(deltaTime);
 
       camera.LookAt = knight->position + glm::vec3(0, 5.0f, 0.0);
+      if (benchmark)
+        camera.Yaw += Benchmark::ORBIT_DEGREES_PER_FRAME;
       camera.UpdateCameraVectors();
 
-      // view/projection transformations
-      glm::mat4 projection =
-          glm::perspective(glm::radians(camera.Zoom),
-                           (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-      glm::mat4 view = camera.GetViewMatrix();
-
-      glDepthMask(GL_FALSE);
-      sky.draw(skyboxShader, view, projection);
-      glDepthMask(GL_TRUE);
-
-      grass.draw(grassFieldShader, currentFrame, view, projection);
-
-      // render the loaded model
+      // animate the models (world matrices, bone palettes, weapon positions)
       glm::mat4 model = glm::mat4(1.0f);
       // Knight position is already updated above
-      knight->draw(model, projection, view, texturedModelWithBonesShader,
-                   simple3dShader, deltaTime, lastFrame);
-
-      model = glm::mat4(1.0f);
+      knight->update(model, deltaTime);
       hornet->updatePosition(deltaTime);
-      hornet->draw(model, projection, view, texturedModelWithBonesShader,
-                   simple3dShader, deltaTime, lastFrame);
-
-      ground.Draw(groundShader.ID, view, projection);
+      hornet->update(model, deltaTime);
+      for (ModelAnimationAbs &member : horde) {
+        if (member.animator.isOver())
+          member.animator.m_CurrentTime = 0.0f; // loop
+        member.update(model, deltaTime);
+      }
 
       if (currentFrame - firstRender > 3.0f) {
         if (hornetState == HornetState::IDLE &&
@@ -647,75 +1318,67 @@ int main() {
         updateKnightState();
       }
 
-      // Check if knight body hit hornet
-      if (hornetState != HornetState::DEAD &&
-          lastFrame > DAMAGE_COOLDOWN + knight->lastHit &&
-          CheckAABBCollision(knight->position, knight->modelSize,
-                             hornet->position, hornet->modelSize)) {
-        // knight->position +=
-        //     glm::normalize(knight->position - hornet->position) * 1.0f;
-        knight->velocity +=
-            glm::normalize(knight->position - hornet->position) *
-            KNOCKBACK_SPEED;
-        playerTakeDamage(1);
-        knight->lastHit = lastFrame;
+      checkCollisions();
+
+      // record the frame
+      // ----------------
+      frame.playing = true;
+      frame.time = currentFrame;
+      frame.fbWidth = (int)SCR_WIDTH;
+      frame.fbHeight = (int)SCR_HEIGHT;
+      if (!benchmark)
+        glfwGetFramebufferSize(window, &frame.fbWidth, &frame.fbHeight);
+      frame.camera = camera;
+      frame.actorCount = frame.instancedCount = 0;
+      frame.addActor(*knight, false);
+      frame.addActor(*hornet, instancedHornets);
+      for (ModelAnimationAbs &member : horde)
+        frame.addActor(member, instancedHornets);
+      for (ModelAnimationAbs &prop : props)
+        frame.addActor(prop, false);
+      frame.immediate.begin();
+      frame.showHitboxes = showHitboxes;
+      if (showHitboxes) {
+        knight->drawHitboxes(frame.immediate);
+        hornet->drawHitboxes(frame.immediate);
       }
-
-      // Check if knight's nail hit hornet
-      if (hornetState != HornetState::DEAD &&
-          knightState == KnightState::ATTACKING &&
-          lastFrame > DAMAGE_COOLDOWN + hornet->lastHit &&
-          CheckAABBCollision(knight->getWeaponPosition(),
-                             knight->model->weaponSize, hornet->position,
-                             hornet->modelSize)) {
-        // std::cout << "HIT " << lastFrame << std::endl;
-        // hornet->position +=
-        //     glm::normalize(hornet->position - knight->position) * 1.0f;
-        hornet->velocity +=
-            glm::normalize(hornet->position - knight->position) *
-            KNOCKBACK_SPEED;
-
-        hornet->lastHit = lastFrame;
-        hornet->health -= 1;
-        if (hornet->health == 0) {
-          game_over_time = static_cast<float>(glfwGetTime());
-          menu_state = MenuType::WIN;
-        }
-        if (hornet->health == 0) {
-          hornetState = HornetState::DEAD;
-        }
-      }
-
-      // Check if hornet's needle hit knight
-      if (hornetState != HornetState::DEAD &&
-          lastFrame > DAMAGE_COOLDOWN + knight->lastHit &&
-          CheckAABBCollision(knight->position, knight->modelSize,
-                             hornet->getWeaponPosition(),
-                             hornet->model->weaponSize)) {
-        // knight->position +=
-        //     glm::normalize(hornet->position - knight->position) * 1.0f;
-        knight->velocity +=
-            glm::normalize(knight->position - hornet->position) *
-            KNOCKBACK_SPEED;
-        playerTakeDamage(1);
-        knight->lastHit = lastFrame;
+      playerHealth->draw(frame.immediate);
+
+      // the overlays show the last frame the render thread finished
+      frame.collectStats = showStats;
+      const FrameCommands *rendered = renderThread.finished();
+      if (showStats && rendered && rendered->collectStats) {
+        const FrameStats &stats = rendered->stats;
+        RenderStats(stats, renderThread);
+        RenderGpuProfile(stats.gpu, stats.gpuDropped);
+        RenderTextureStreaming(stats.streaming, stats.textures);
+#ifdef HK_PROFILE
+        RenderCpuProfile(renderThread);
+#endif
       }
+    }
 
-      glDisable(GL_DEPTH_TEST);
-      simple2dShader.use();
-      glm::mat4 uiProjection =
-          glm::ortho(0.0f, (float)SCR_WIDTH, 0.0f, (float)SCR_HEIGHT);
-      playerHealth->draw(uiProjection, simple2dShader.ID);
-      glEnable(GL_DEPTH_TEST);
+    {
+      PROFILE_ZONE("ImGui");
+      ImGui::Render();
+      ImGuiRenderer::record(ImGui::GetDrawData(), frame.imgui);
     }
+    frame.writeGpuProfile = std::exchange(writeGpuProfile, false);
+    renderThread.submit();
 
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    if (benchmark) {
+      benchmark->endFrame();
+      if (benchmark->done())
+        glfwSetWindowShouldClose(window, true);
+    }
+  }
+  renderThread.stop();
+  glfwMakeContextCurrent(window);
 
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved
-    // etc.)
-    // -------------------------------------------------------------------------------
-    glfwSwapBuffers(window);
+  int status = 0;
+  if (benchmark) {
+    status = benchmark->finish() ? 0 : 1;
+    gpuProfiler.writeCsv(benchmarkOptions.outDir + "/gpu_profile.csv");
   }
 
   // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -723,15 +1386,17 @@ int main() {
   for (auto &pair : preLoadedSounds) {
     ma_sound_uninit(pair.second.get());
   }
-  ma_engine_uninit(&audioEngine);
+  if (!benchmark)
+    ma_engine_uninit(&audioEngine);
   glfwTerminate();
-  return 0;
+  return status;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this
 // frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window, float deltaTime) {
+  PROFILE_ZONE("processInput");
   float currentFrame = static_cast<float>(glfwGetTime());
   if ((menu_state == MenuType::LOSE || menu_state == MenuType::WIN) &&
       currentFrame >= 2.0 + game_over_time) {
@@ -743,6 +1408,37 @@ void processInput(GLFWwindow *window, float deltaTime) {
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
 
+  static bool statsKeyDown = false;
+  bool statsKey = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+  if (statsKey && !statsKeyDown)
+    showStats = !showStats;
+  statsKeyDown = statsKey;
+
+  static bool hitboxKeyDown = false;
+  bool hitboxKey = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+  if (hitboxKey && !hitboxKeyDown)
+    showHitboxes = !showHitboxes;
+  hitboxKeyDown = hitboxKey;
+
+  static bool csvKeyDown = false;
+  bool csvKey = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+  if (csvKey && !csvKeyDown)
+    writeGpuProfile = true;
+  csvKeyDown = csvKey;
+
+#ifdef HK_PROFILE
+  static bool traceKeyDown = false;
+  bool traceKey = glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS;
+  if (traceKey && !traceKeyDown) {
+    if (CpuProfiler::writeChromeTrace(CPU_TRACE_JSON))
+      std::cout << "CPU trace written to " << CPU_TRACE_JSON << std::endl;
+    else
+      std::cout << "ERROR::CPU_PROFILER:: cannot write " << CPU_TRACE_JSON
+                << std::endl;
+  }
+  traceKeyDown = traceKey;
+#endif
+
   glm::vec3 moveDir(0.0f);
   glm::vec3 forwardXY =
       glm::normalize(glm::vec3(camera.Front.x, 0, camera.Front.z));
@@ -780,15 +1476,6 @@ void processInput(GLFWwindow *window, float deltaTime) {
   camera.LookAt = knight->position;
 }
 
-// glfw: whenever the window size changed (by OS or user resize) this callback
-// function executes
-// ---------------------------------------------------------------------------------------------
-void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-  // make sure the viewport matches the new window dimensions; note that width
-  // and height will be significantly larger than specified on retina displays.
-  glViewport(0, 0, width, height);
-}
-
 void mouse_button_callback(GLFWwindow *window, int button, int action,
                            int mods) {
   float currentFrame = static_cast<float>(glfwGetTime());
@@ -1,10 +0,0 @@
-#version 430 core
-
-out vec4 FragColor;
-
-uniform vec3 color;
-
-void main()
-{
-    FragColor = vec4(1.0,0.0,0.0, 1.0);
-}
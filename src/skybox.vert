@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 TexCoords;
+
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPos;
+    float time;
+};
+
+void main()
+{
+    TexCoords = aPos;
+    // z = w puts the sky exactly on the far plane, so drawn last with
+    // GL_LEQUAL it only covers pixels nothing else was drawn to
+    // without the translation of the view the sky stays infinitely far away
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
+    gl_Position = pos.xyww;
+}
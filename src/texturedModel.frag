@@ -1,30 +1,48 @@
 #version 460 core
+// Specialized like texturedModel.vert:
+//   HIT_FLASH      the whole draw is white (a damaged actor)
+//   INSTANCED      the flash is decided per instance instead
+//   TEXTURE_ARRAY  the diffuse map is layer DiffuseLayer of
+//                  texture_diffuse_array (Model::packTextureArrays)
+//   ALPHA_TEST     texels below half alpha are discarded
 
 // === Inputs ===
 in vec2 TexCoords;
+flat in int DiffuseLayer;
+#ifdef INSTANCED
+flat in int Hit;
+#endif
 
 // === Outputs ===
 out vec4 FragColor;
 
 // === Uniforms ===
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray texture_diffuse_array;
+#else
 uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_base_color1;
-uniform vec3 uBaseColor = vec3(0.0);
-
-uniform bool isHit = true;
+#endif
 
 void main()
 {
-    if(isHit){
-      FragColor=vec4(1.0);
-      return;
+#ifdef HIT_FLASH
+    FragColor = vec4(1.0);
+#else
+#ifdef INSTANCED
+    if (Hit != 0) {
+        FragColor = vec4(1.0);
+        return;
     }
-    // Sample diffuse texture first
-    vec3 color = texture(texture_diffuse1, TexCoords).rgb;
-
-    // Fallback to PBR base color
-     if (length(color) < 0.01)
-        color = texture(texture_base_color1, TexCoords).rgb;
-
-    FragColor = vec4(color, 1.0);
+#endif
+#ifdef TEXTURE_ARRAY
+    vec4 texel = texture(texture_diffuse_array, vec3(TexCoords, DiffuseLayer));
+#else
+    vec4 texel = texture(texture_diffuse1, TexCoords);
+#endif
+#ifdef ALPHA_TEST
+    if (texel.a < 0.5)
+        discard;
+#endif
+    FragColor = vec4(texel.rgb, 0.3);
+#endif
 }
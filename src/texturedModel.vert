@@ -1,14 +1,162 @@
+#version 430 core
+// Every model draw, specialized by the ShaderFeature #defines that
+// ShaderVariants inserts after the #version line (shader_variants.hpp):
+//   SKINNED    blend the vertex by up to four bones; with INFLUENCES_1 or
+//              INFLUENCES_2 by one or two, with RIGID by the draw's
+//              rigidBone alone (Mesh::skinGroups)
+//   INSTANCED  world matrix, bone palette and hit flag per instance, for
+//              InstancedModel
+//   INDIRECT   world matrix from draws[drawId], for RenderQueue's
+//              multi-draws of MeshPool meshes
+// Without INSTANCED or INDIRECT the world matrix comes from the Draw block.
 
-#version 330 core
-layout (location = 0) in vec3 aPos;
+#if defined(INDIRECT) && (defined(SKINNED) || defined(INSTANCED))
+#error INDIRECT draws static meshes one instance at a time
+#endif
 
-out vec3 TexCoords;
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+#ifdef SKINNED
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+#endif
+#ifdef INDIRECT
+// MeshPool::DRAW_ID_LOCATION; the command's baseInstance, as gl_BaseInstance
+// would need GL 4.6
+layout(location = 7) in uint drawId;
+#endif
 
-uniform mat4 projection;
-uniform mat4 view;
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+
+// pushed through the UniformRing (uniform_ring.hpp), see FrameBlock and
+// ObjectBlock there
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPos;
+    float time;
+};
+
+#ifdef INDIRECT
+struct DrawData {
+    mat4 model;
+    int isHit;
+    int diffuseLayer;
+    int instanceBase;
+    int rigidBone;
+};
+
+layout(std430, binding = 2) readonly buffer Draws {
+    DrawData draws[];
+};
+#else
+// INSTANCED only reads diffuseLayer, instanceBase (its first record) and
+// rigidBone
+layout(std140) uniform Draw {
+    mat4 model;
+    int isHit;
+    int diffuseLayer;
+    int instanceBase;
+    int rigidBone;
+};
+#endif
+
+#ifdef INSTANCED
+struct Instance {
+    mat4 model;
+    uint palette; // first bone of this actor in palettes[]
+    uint hit;
+};
+
+layout(std430, binding = 0) readonly buffer Palettes {
+    mat4 palettes[];
+};
+
+layout(std430, binding = 1) readonly buffer Instances {
+    Instance instances[];
+};
+#elif defined(SKINNED)
+layout(std140) uniform Bones {
+    mat4 finalBonesMatrices[MAX_BONES];
+};
+#endif
+
+out vec2 TexCoords;
+flat out int DiffuseLayer;
+#ifdef INSTANCED
+flat out int Hit;
+#endif
+
+#ifdef SKINNED
+mat4 boneMatrix(uint palette, int bone)
+{
+#ifdef INSTANCED
+    return palettes[palette + uint(bone)];
+#else
+    return finalBonesMatrices[bone];
+#endif
+}
+
+#ifdef RIGID
+// the whole group follows one bone, so the weights are not even read
+vec4 skin(uint palette)
+{
+    return boneMatrix(palette, rigidBone) * vec4(pos, 1.0f);
+}
+#else
+#if defined(INFLUENCES_1)
+const int INFLUENCES = 1;
+#elif defined(INFLUENCES_2)
+const int INFLUENCES = 2;
+#else
+const int INFLUENCES = MAX_BONE_INFLUENCE;
+#endif
+
+// Mesh::normalizeWeights() stripped invalid ids and moved the used weights to
+// the front, summing to 1, so the first INFLUENCES slots blend unchecked.
+// A vertex no bone moves has all weights 0 and keeps its bind pose through
+// the 1 - total term.
+vec4 skin(uint palette)
+{
+    vec4 position = vec4(pos, 1.0f);
+    mat4 blend = boneMatrix(palette, boneIds[0]) * weights[0];
+    float total = weights[0];
+    for (int i = 1; i < INFLUENCES; i++)
+    {
+        blend += boneMatrix(palette, boneIds[i]) * weights[i];
+        total += weights[i];
+    }
+    return blend * position + (1.0f - total) * position;
+}
+#endif
+#endif
 
 void main()
 {
-    TexCoords = aPos;
-    gl_Position = projection * view * vec4(aPos, 1.0);
-}  
\ No newline at end of file
+#if defined(INDIRECT)
+    DrawData draw = draws[drawId];
+    mat4 world = draw.model;
+    DiffuseLayer = draw.diffuseLayer;
+#elif defined(INSTANCED)
+    Instance instance = instances[instanceBase + gl_InstanceID];
+    mat4 world = instance.model;
+    DiffuseLayer = diffuseLayer;
+    Hit = int(instance.hit);
+#else
+    mat4 world = model;
+    DiffuseLayer = diffuseLayer;
+#endif
+
+#if defined(SKINNED) && defined(INSTANCED)
+    vec4 position = skin(instance.palette);
+#elif defined(SKINNED)
+    vec4 position = skin(0u);
+#else
+    vec4 position = vec4(pos, 1.0f);
+#endif
+
+    gl_Position = projection * view * world * position;
+    TexCoords = tex;
+}
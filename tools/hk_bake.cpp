@@ -0,0 +1,659 @@
+// hk_bake: offline asset baker.
+//
+// Walks resources/, imports every model through the same Model/Animation code
+// the game uses (without a GL context) and writes runtime-ready caches to
+// cache/baked:
+//   models/*.hkmesh    vertex/index data, node transforms and bone offsets
+//   models/*.hkanim    animation channels (position/rotation/scale keys)
+//   textures/*.hktex   decoded, mipmapped and DXT compressed pixels, flipped
+//                      where the game flips them (embedded PNG/JPG only)
+//   audio/*.wav        mp3 and friends decoded to 16-bit PCM
+//
+// Work is spread over all cores and only sources whose content hash changed
+// are rebuilt. Output bytes only depend on the inputs, never on timing or the
+// number of threads, so two bakes of the same tree diff clean.
+//
+// Run from the repository root:  bin/hk_bake [-j threads] [--force]
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <learnopengl/animation.h>
+#include <learnopengl/baked_asset.hpp>
+#include <learnopengl/model_animation.h>
+
+extern "C" {
+#include "image_DXT.h"
+}
+
+#define MINIAUDIO_IMPLEMENTATION
+#include <miniaudio.h>
+
+namespace fs = std::filesystem;
+using BakedAssets::Reader;
+using BakedAssets::Writer;
+
+// keep in sync with ModelAnimationAbs
+const unsigned int IMPORT_FLAGS = aiProcess_Triangulate |
+                                  aiProcess_GenSmoothNormals |
+                                  aiProcess_CalcTangentSpace |
+                                  aiProcess_GenBoundingBoxes;
+
+const std::set<std::string> MODEL_EXTENSIONS = {".glb", ".gltf", ".fbx",
+                                                ".obj", ".dae"};
+const std::set<std::string> AUDIO_EXTENSIONS = {".mp3", ".wav", ".ogg",
+                                                ".flac"};
+
+std::mutex logMutex;
+void report(const std::string &line) {
+  std::lock_guard<std::mutex> lock(logMutex);
+  std::cerr << line << std::endl;
+}
+
+// ----------------------------------------------------------------------
+// Incremental state
+// ----------------------------------------------------------------------
+// manifest.txt holds content hashes only so it is as deterministic as the
+// outputs; stamps.txt caches size/mtime per source to skip rehashing.
+struct Stamp {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  uint64_t hash = 0;
+};
+
+struct ManifestEntry {
+  std::string kind;
+  uint64_t hash = 0;
+  std::vector<std::string> textures; // external texture sources of a model
+  std::vector<std::string> embedded; // .hktex outputs of its embedded ones
+};
+
+std::map<std::string, Stamp> stamps;
+std::map<std::string, ManifestEntry> previousManifest;
+std::map<std::string, ManifestEntry> manifest;
+std::mutex stateMutex;
+bool forceRebuild = false;
+
+std::string manifestPath() { return BakedAssets::root() + "/manifest.txt"; }
+std::string stampsPath() { return BakedAssets::root() + "/stamps.txt"; }
+
+void loadState() {
+  std::ifstream in(manifestPath());
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream ss(line);
+    std::string kind, path, hash, textures, embedded;
+    if (!std::getline(ss, kind, '\t') || !std::getline(ss, path, '\t') ||
+        !std::getline(ss, hash, '\t'))
+      continue;
+    ManifestEntry entry;
+    entry.kind = kind;
+    entry.hash = std::stoull(hash, nullptr, 16);
+    if (std::getline(ss, textures, '\t')) {
+      std::istringstream ts(textures);
+      std::string tex;
+      while (std::getline(ts, tex, ','))
+        entry.textures.push_back(tex);
+    }
+    if (std::getline(ss, embedded, '\t')) {
+      std::istringstream es(embedded);
+      std::string output;
+      while (std::getline(es, output, ','))
+        entry.embedded.push_back(output);
+    }
+    previousManifest[path] = entry;
+  }
+
+  std::ifstream stampIn(stampsPath());
+  while (std::getline(stampIn, line)) {
+    std::istringstream ss(line);
+    std::string path;
+    Stamp stamp;
+    std::string hash;
+    if (std::getline(ss, path, '\t') && ss >> stamp.size >> stamp.mtime >> hash) {
+      stamp.hash = std::stoull(hash, nullptr, 16);
+      stamps[path] = stamp;
+    }
+  }
+}
+
+void saveState() {
+  std::ofstream out(manifestPath(), std::ios::trunc);
+  for (auto &[path, entry] : manifest) {
+    out << entry.kind << '\t' << path << '\t' << BakedAssets::hex(entry.hash);
+    if (!entry.textures.empty() || !entry.embedded.empty()) {
+      out << '\t';
+      for (size_t i = 0; i < entry.textures.size(); i++)
+        out << (i ? "," : "") << entry.textures[i];
+    }
+    if (!entry.embedded.empty()) {
+      out << '\t';
+      for (size_t i = 0; i < entry.embedded.size(); i++)
+        out << (i ? "," : "") << entry.embedded[i];
+    }
+    out << '\n';
+  }
+
+  std::ofstream stampOut(stampsPath(), std::ios::trunc);
+  for (auto &[path, stamp] : stamps)
+    stampOut << path << '\t' << stamp.size << ' ' << stamp.mtime << ' '
+             << BakedAssets::hex(stamp.hash) << '\n';
+}
+
+std::vector<unsigned char> readFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), {});
+}
+
+// content hash of a source file, reusing the cached one when size and mtime
+// are unchanged
+uint64_t fileHash(const std::string &path) {
+  std::error_code ec;
+  uint64_t size = fs::file_size(path, ec);
+  int64_t mtime =
+      (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto it = stamps.find(path);
+    if (it != stamps.end() && it->second.size == size &&
+        it->second.mtime == mtime)
+      return it->second.hash;
+  }
+  std::vector<unsigned char> data = readFile(path);
+  uint64_t hash =
+      BakedAssets::hashBytes(data.data(), data.size(), BakedAssets::VERSION);
+  std::lock_guard<std::mutex> lock(stateMutex);
+  stamps[path] = {size, mtime, hash};
+  return hash;
+}
+
+bool upToDate(const std::string &path, uint64_t hash,
+              const std::vector<std::string> &outputs) {
+  if (forceRebuild)
+    return false;
+  auto it = previousManifest.find(path);
+  if (it == previousManifest.end() || it->second.hash != hash)
+    return false;
+  std::error_code ec;
+  for (const std::string &output : outputs)
+    if (!fs::exists(output, ec))
+      return false;
+  return true;
+}
+
+void record(const std::string &path, const std::string &kind, uint64_t hash,
+            std::vector<std::string> textures = {},
+            std::vector<std::string> embedded = {}) {
+  std::lock_guard<std::mutex> lock(stateMutex);
+  manifest[path] = {kind, hash, std::move(textures), std::move(embedded)};
+}
+
+// ----------------------------------------------------------------------
+// Textures
+// ----------------------------------------------------------------------
+struct TextureRequest {
+  std::string output;
+  std::string source;                 // external file, empty if embedded
+  std::vector<unsigned char> embedded; // compressed file bytes or raw texels
+  int rawWidth = 0, rawHeight = 0;     // set for raw (uncompressed) texels
+};
+
+// 2x2 box filter; odd edges clamp so every GL mip size is produced
+BakedAssets::TextureLevel downsample(const BakedAssets::TextureLevel &src,
+                                     int channels) {
+  BakedAssets::TextureLevel dst;
+  dst.width = std::max(1u, src.width / 2);
+  dst.height = std::max(1u, src.height / 2);
+  dst.data.resize((size_t)dst.width * dst.height * channels);
+  for (uint32_t y = 0; y < dst.height; y++) {
+    uint32_t y0 = std::min(y * 2, src.height - 1);
+    uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+    for (uint32_t x = 0; x < dst.width; x++) {
+      uint32_t x0 = std::min(x * 2, src.width - 1);
+      uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+      for (int c = 0; c < channels; c++) {
+        auto at = [&](uint32_t px, uint32_t py) {
+          return (unsigned)src.data[((size_t)py * src.width + px) * channels + c];
+        };
+        unsigned sum = at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1);
+        dst.data[((size_t)y * dst.width + x) * channels + c] =
+            (unsigned char)((sum + 2) / 4);
+      }
+    }
+  }
+  return dst;
+}
+
+bool bakeTexture(const TextureRequest &request) {
+  int width = 0, height = 0, channels = 0;
+  bool flipped = false;
+  std::vector<unsigned char> pixels;
+
+  if (request.rawWidth > 0) {
+    // raw embedded texels are uploaded as-is at runtime, no flip
+    width = request.rawWidth;
+    height = request.rawHeight;
+    channels = 4;
+    pixels = request.embedded;
+  } else {
+    unsigned char *data = nullptr;
+    if (request.source.empty())
+      data = stbi_load_from_memory(request.embedded.data(),
+                                   (int)request.embedded.size(), &width,
+                                   &height, &channels, 0);
+    else
+      data = stbi_load(request.source.c_str(), &width, &height, &channels, 0);
+    if (!data) {
+      report("  failed to decode " +
+          (request.source.empty() ? request.output : request.source));
+      return false;
+    }
+    // the game loads embedded PNG/JPG with stb's vertical flip enabled and
+    // files on disk without it
+    flipped = request.source.empty();
+    size_t row = (size_t)width * channels;
+    pixels.resize(row * height);
+    for (int y = 0; y < height; y++)
+      std::memcpy(&pixels[(size_t)(flipped ? height - 1 - y : y) * row],
+                  data + y * row, row);
+    stbi_image_free(data);
+  }
+
+  BakedAssets::Texture tex;
+  tex.channels = channels;
+  tex.flipped = flipped;
+  tex.format = channels == 3   ? BakedAssets::TextureFormat::DXT1
+               : channels == 4 ? BakedAssets::TextureFormat::DXT5
+                               : BakedAssets::TextureFormat::RAW;
+
+  BakedAssets::TextureLevel level;
+  level.width = width;
+  level.height = height;
+  level.data = std::move(pixels);
+  while (true) {
+    BakedAssets::TextureLevel next;
+    bool last = level.width == 1 && level.height == 1;
+    if (!last)
+      next = downsample(level, channels);
+
+    if (tex.format == BakedAssets::TextureFormat::RAW) {
+      tex.levels.push_back(level);
+    } else {
+      int size = 0;
+      unsigned char *compressed =
+          tex.format == BakedAssets::TextureFormat::DXT1
+              ? convert_image_to_DXT1(level.data.data(), level.width,
+                                      level.height, channels, &size)
+              : convert_image_to_DXT5(level.data.data(), level.width,
+                                      level.height, channels, &size);
+      BakedAssets::TextureLevel out;
+      out.width = level.width;
+      out.height = level.height;
+      out.data.assign(compressed, compressed + size);
+      free(compressed);
+      tex.levels.push_back(std::move(out));
+    }
+    if (last)
+      break;
+    level = std::move(next);
+  }
+  return BakedAssets::writeTexture(request.output, tex);
+}
+
+// ----------------------------------------------------------------------
+// Models and animations
+// ----------------------------------------------------------------------
+void writeMesh(Writer &w, const Mesh &mesh, const aiScene *scene,
+               const std::string &directory) {
+  w.str(mesh.name);
+  w.str(mesh.nodeName);
+  w.pod((uint8_t)mesh.hasBones);
+  w.pod(mesh.mAABB.mMin);
+  w.pod(mesh.mAABB.mMax);
+
+  // tangents are never filled in by Model::processMesh, so they are left out
+  // rather than leaking uninitialised memory into the cache
+  w.pod((uint32_t)mesh.vertices.size());
+  for (const Vertex &v : mesh.vertices) {
+    w.pod(v.Position);
+    w.pod(v.Normal);
+    w.pod(v.TexCoords);
+    w.bytes(v.m_BoneIDs, sizeof(v.m_BoneIDs));
+    w.bytes(v.m_Weights, sizeof(v.m_Weights));
+  }
+  w.pod((uint32_t)mesh.indices.size());
+  w.bytes(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+
+  w.pod((uint32_t)mesh.textures.size());
+  for (const Texture &tex : mesh.textures) {
+    w.str(tex.type);
+    std::string file =
+        tex.path[0] == '*'
+            ? BakedAssets::embeddedTextureFile(
+                  scene->mTextures[atoi(tex.path.c_str() + 1)])
+            : BakedAssets::textureFile(directory + '/' + tex.path);
+    w.str(fs::path(file).filename().string());
+  }
+}
+
+void writeModel(const std::string &output, Model &model, const aiScene *scene) {
+  Writer w(output);
+  w.pod(BakedAssets::MESH_MAGIC);
+  w.pod(BakedAssets::VERSION);
+
+  w.pod((uint32_t)model.meshes.size());
+  for (const Mesh &mesh : model.meshes)
+    writeMesh(w, mesh, scene, model.directory);
+
+  std::map<std::string, glm::mat4> nodes(model.meshNodeTransforms.begin(),
+                                         model.meshNodeTransforms.end());
+  w.pod((uint32_t)nodes.size());
+  for (auto &[name, transform] : nodes) {
+    w.str(name);
+    w.pod(transform);
+  }
+
+  auto &bones = model.GetBoneInfoMap();
+  w.pod((uint32_t)bones.size());
+  for (auto &[name, info] : bones) {
+    w.str(name);
+    w.pod((int32_t)info.id);
+    w.pod(info.offset);
+  }
+}
+
+void writeAnimations(const std::string &output,
+                     const std::vector<Animation> &animations) {
+  Writer w(output);
+  w.pod(BakedAssets::ANIM_MAGIC);
+  w.pod(BakedAssets::VERSION);
+  w.pod((uint32_t)animations.size());
+  for (const Animation &anim : animations) {
+    w.str(anim.name);
+    w.pod(anim.m_Duration);
+    w.pod((int32_t)anim.m_TicksPerSecond);
+    w.pod(anim.m_GlobalInverseTransform);
+
+    const aiAnimation *src = anim.animation;
+    w.pod((uint32_t)src->mNumChannels);
+    for (unsigned int i = 0; i < src->mNumChannels; i++) {
+      const aiNodeAnim *channel = src->mChannels[i];
+      w.str(channel->mNodeName.C_Str());
+      w.pod((uint32_t)channel->mNumPositionKeys);
+      for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+        w.pod((float)channel->mPositionKeys[k].mTime);
+        w.pod(AssimpGLMHelpers::GetGLMVec(channel->mPositionKeys[k].mValue));
+      }
+      w.pod((uint32_t)channel->mNumRotationKeys);
+      for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+        const aiQuaternion &q = channel->mRotationKeys[k].mValue;
+        w.pod((float)channel->mRotationKeys[k].mTime);
+        w.pod(glm::vec4(q.w, q.x, q.y, q.z));
+      }
+      w.pod((uint32_t)channel->mNumScalingKeys);
+      for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+        w.pod((float)channel->mScalingKeys[k].mTime);
+        w.pod(AssimpGLMHelpers::GetGLMVec(channel->mScalingKeys[k].mValue));
+      }
+    }
+  }
+}
+
+// a model's inputs are the file itself plus any sibling buffers (.bin)
+uint64_t modelHash(const std::string &path) {
+  uint64_t hash = fileHash(path);
+  std::vector<std::string> buffers;
+  std::error_code ec;
+  for (auto &entry : fs::directory_iterator(fs::path(path).parent_path(), ec))
+    if (entry.is_regular_file() && entry.path().extension() == ".bin")
+      buffers.push_back(entry.path().generic_string());
+  std::sort(buffers.begin(), buffers.end());
+  for (const std::string &buffer : buffers) {
+    uint64_t h = fileHash(buffer);
+    hash = BakedAssets::hashBytes(&h, sizeof(h), hash);
+  }
+  return hash;
+}
+
+void bakeModel(const std::string &path, std::vector<TextureRequest> &textures) {
+  uint64_t hash = modelHash(path);
+  std::string meshOut = BakedAssets::modelFile(path);
+  std::string animOut = BakedAssets::animationFile(path);
+  std::string directory = fs::path(path).parent_path().generic_string();
+
+  // read-only while the workers run, so find() and never operator[]
+  auto previous = previousManifest.find(path);
+  std::vector<std::string> outputs = {meshOut, animOut};
+  if (previous != previousManifest.end())
+    outputs.insert(outputs.end(), previous->second.embedded.begin(),
+                   previous->second.embedded.end());
+  if (upToDate(path, hash, outputs)) {
+    // unchanged, embedded textures included; external textures still get
+    // their own up-to-date check
+    for (const std::string &source : previous->second.textures)
+      textures.push_back({BakedAssets::textureFile(source), source, {}, 0, 0});
+    record(path, "model", hash, previous->second.textures,
+           previous->second.embedded);
+    return;
+  }
+
+  report("model   " + path);
+  Assimp::Importer importer;
+  const aiScene *scene = importer.ReadFile(path, IMPORT_FLAGS);
+  if (!scene || !scene->mRootNode) {
+    report("  " + std::string(importer.GetErrorString()));
+    return;
+  }
+
+  Model model(scene, directory, glm::vec3(1.0f), fs::path(path).stem().string(),
+              "", false, true);
+  std::vector<Animation> animations;
+  for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+    aiAnimation *anim = scene->mAnimations[i];
+    animations.emplace_back(*scene, anim, anim->mName.C_Str(), &model);
+  }
+
+  writeModel(meshOut, model, scene);
+  writeAnimations(animOut, animations);
+
+  std::set<std::string> externalSources;
+  std::set<std::string> embeddedSeen;
+  for (const Mesh &mesh : model.meshes) {
+    for (const Texture &tex : mesh.textures) {
+      if (tex.path[0] == '*') {
+        const aiTexture *src = scene->mTextures[atoi(tex.path.c_str() + 1)];
+        std::string output = BakedAssets::embeddedTextureFile(src);
+        if (!embeddedSeen.insert(output).second)
+          continue;
+        TextureRequest request;
+        request.output = output;
+        const unsigned char *bytes =
+            reinterpret_cast<const unsigned char *>(src->pcData);
+        request.embedded.assign(bytes, bytes + BakedAssets::embeddedSize(src));
+        if (src->mHeight != 0) {
+          request.rawWidth = src->mWidth;
+          request.rawHeight = src->mHeight;
+        }
+        textures.push_back(std::move(request));
+      } else {
+        externalSources.insert(directory + '/' + tex.path);
+      }
+    }
+  }
+  for (const std::string &source : externalSources)
+    textures.push_back({BakedAssets::textureFile(source), source, {}, 0, 0});
+
+  record(path, "model", hash,
+         std::vector<std::string>(externalSources.begin(),
+                                  externalSources.end()),
+         std::vector<std::string>(embeddedSeen.begin(), embeddedSeen.end()));
+}
+
+// ----------------------------------------------------------------------
+// Audio
+// ----------------------------------------------------------------------
+void bakeAudio(const std::string &path) {
+  uint64_t hash = fileHash(path);
+  std::string output = BakedAssets::audioFile(path);
+  if (upToDate(path, hash, {output})) {
+    record(path, "audio", hash);
+    return;
+  }
+
+  report("audio   " + path);
+  ma_decoder_config config = ma_decoder_config_init(ma_format_s16, 0, 0);
+  ma_decoder decoder;
+  if (ma_decoder_init_file(path.c_str(), &config, &decoder) != MA_SUCCESS) {
+    report("  failed to decode " + path);
+    return;
+  }
+
+  uint32_t channels = decoder.outputChannels;
+  uint32_t sampleRate = decoder.outputSampleRate;
+  std::vector<int16_t> samples;
+  std::vector<int16_t> chunk(4096 * channels);
+  while (true) {
+    ma_uint64 framesRead = 0;
+    ma_result result =
+        ma_decoder_read_pcm_frames(&decoder, chunk.data(), 4096, &framesRead);
+    samples.insert(samples.end(), chunk.begin(),
+                   chunk.begin() + framesRead * channels);
+    if (result != MA_SUCCESS || framesRead == 0)
+      break;
+  }
+  ma_decoder_uninit(&decoder);
+
+  uint32_t dataSize = (uint32_t)(samples.size() * sizeof(int16_t));
+  Writer w(output);
+  w.bytes("RIFF", 4);
+  w.pod((uint32_t)(36 + dataSize));
+  w.bytes("WAVEfmt ", 8);
+  w.pod((uint32_t)16);
+  w.pod((uint16_t)1); // PCM
+  w.pod((uint16_t)channels);
+  w.pod(sampleRate);
+  w.pod((uint32_t)(sampleRate * channels * sizeof(int16_t)));
+  w.pod((uint16_t)(channels * sizeof(int16_t)));
+  w.pod((uint16_t)16);
+  w.bytes("data", 4);
+  w.pod(dataSize);
+  w.bytes(samples.data(), dataSize);
+
+  record(path, "audio", hash);
+}
+
+// ----------------------------------------------------------------------
+template <typename Fn>
+void parallelFor(size_t count, unsigned int threads, Fn fn) {
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < threads; t++)
+    workers.emplace_back([&]() {
+      for (size_t i = next++; i < count; i = next++)
+        fn(i);
+    });
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+int main(int argc, char **argv) {
+  unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string resources = "resources";
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc)
+      threads = std::max(1, atoi(argv[++i]));
+    else if (arg == "--force")
+      forceRebuild = true;
+    else if (arg == "--resources" && i + 1 < argc)
+      resources = argv[++i];
+    else if (arg == "--out" && i + 1 < argc)
+      BakedAssets::root() = argv[++i];
+    else {
+      std::cerr << "usage: hk_bake [-j threads] [--force] [--resources dir] "
+                   "[--out dir]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  for (const char *sub : {"/models", "/textures", "/audio"})
+    fs::create_directories(BakedAssets::root() + sub);
+  loadState();
+
+  std::vector<std::string> models, sounds;
+  for (auto &entry : fs::recursive_directory_iterator(resources)) {
+    if (!entry.is_regular_file())
+      continue;
+    std::string ext = entry.path().extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (MODEL_EXTENSIONS.count(ext))
+      models.push_back(entry.path().generic_string());
+    else if (AUDIO_EXTENSIONS.count(ext))
+      sounds.push_back(entry.path().generic_string());
+  }
+  std::sort(models.begin(), models.end());
+  std::sort(sounds.begin(), sounds.end());
+
+  // phase 1: models and audio; models report the textures they reference
+  std::vector<std::vector<TextureRequest>> perModel(models.size());
+  parallelFor(models.size() + sounds.size(), threads, [&](size_t i) {
+    if (i < models.size())
+      bakeModel(models[i], perModel[i]);
+    else
+      bakeAudio(sounds[i - models.size()]);
+  });
+
+  // phase 2: textures, deduplicated across models by output file
+  std::map<std::string, TextureRequest> unique;
+  for (auto &requests : perModel)
+    for (TextureRequest &request : requests)
+      unique.emplace(request.output, std::move(request));
+  std::vector<TextureRequest *> textures;
+  for (auto &[output, request] : unique)
+    textures.push_back(&request);
+
+  std::atomic<int> baked{0};
+  parallelFor(textures.size(), threads, [&](size_t i) {
+    TextureRequest &request = *textures[i];
+    if (!request.source.empty()) {
+      uint64_t hash = fileHash(request.source);
+      if (upToDate(request.source, hash, {request.output})) {
+        record(request.source, "texture", hash);
+        return;
+      }
+      report("texture " + request.source);
+      if (bakeTexture(request))
+        record(request.source, "texture", hash);
+    } else {
+      std::error_code ec;
+      if (!forceRebuild && fs::exists(request.output, ec))
+        return;
+      report("texture " + request.output);
+      bakeTexture(request);
+    }
+    baked++;
+  });
+
+  saveState();
+  std::cerr << "hk_bake: " << models.size() << " models, " << sounds.size()
+            << " sounds, " << textures.size() << " textures (" << baked
+            << " rebuilt)" << std::endl;
+  return 0;
+}